@@ -12,14 +12,15 @@ Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
 #endif
 
 // add_multi_cpp
-Rcpp::NumericMatrix add_multi_cpp(const std::vector<std::string>& seqs, const int k, const std::vector<std::string>& alph);
-RcppExport SEXP _universalmotif_add_multi_cpp(SEXP seqsSEXP, SEXP kSEXP, SEXP alphSEXP) {
+Rcpp::NumericMatrix add_multi_cpp(const std::vector<std::string>& seqs, const int k, const std::vector<std::string>& alph, const int nthreads);
+RcppExport SEXP _universalmotif_add_multi_cpp(SEXP seqsSEXP, SEXP kSEXP, SEXP alphSEXP, SEXP nthreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::traits::input_parameter< const std::vector<std::string>& >::type seqs(seqsSEXP);
     Rcpp::traits::input_parameter< const int >::type k(kSEXP);
     Rcpp::traits::input_parameter< const std::vector<std::string>& >::type alph(alphSEXP);
-    rcpp_result_gen = Rcpp::wrap(add_multi_cpp(seqs, k, alph));
+    Rcpp::traits::input_parameter< const int >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(add_multi_cpp(seqs, k, alph, nthreads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -140,6 +141,40 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// mask_complexity_cpp
+Rcpp::List mask_complexity_cpp(const std::vector<std::string>& seqs, const std::vector<std::size_t>& windows, const std::vector<std::size_t>& overlaps, const std::string& metric, const std::string& alph, const int maxWordSize, const double threshold, const std::string& letter, const int nthreads);
+RcppExport SEXP _universalmotif_mask_complexity_cpp(SEXP seqsSEXP, SEXP windowsSEXP, SEXP overlapsSEXP, SEXP metricSEXP, SEXP alphSEXP, SEXP maxWordSizeSEXP, SEXP thresholdSEXP, SEXP letterSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const std::vector<std::string>& >::type seqs(seqsSEXP);
+    Rcpp::traits::input_parameter< const std::vector<std::size_t>& >::type windows(windowsSEXP);
+    Rcpp::traits::input_parameter< const std::vector<std::size_t>& >::type overlaps(overlapsSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type metric(metricSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type alph(alphSEXP);
+    Rcpp::traits::input_parameter< const int >::type maxWordSize(maxWordSizeSEXP);
+    Rcpp::traits::input_parameter< const double >::type threshold(thresholdSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type letter(letterSEXP);
+    Rcpp::traits::input_parameter< const int >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(mask_complexity_cpp(seqs, windows, overlaps, metric, alph, maxWordSize, threshold, letter, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// sliding_complexity_seqs_cpp
+Rcpp::List sliding_complexity_seqs_cpp(const std::vector<std::string>& seqs, const std::vector<std::size_t>& windows, const std::vector<std::size_t>& overlaps, const std::string& metric, const std::string& alph, const int maxWordSize, const int nthreads);
+RcppExport SEXP _universalmotif_sliding_complexity_seqs_cpp(SEXP seqsSEXP, SEXP windowsSEXP, SEXP overlapsSEXP, SEXP metricSEXP, SEXP alphSEXP, SEXP maxWordSizeSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const std::vector<std::string>& >::type seqs(seqsSEXP);
+    Rcpp::traits::input_parameter< const std::vector<std::size_t>& >::type windows(windowsSEXP);
+    Rcpp::traits::input_parameter< const std::vector<std::size_t>& >::type overlaps(overlapsSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type metric(metricSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type alph(alphSEXP);
+    Rcpp::traits::input_parameter< const int >::type maxWordSize(maxWordSizeSEXP);
+    Rcpp::traits::input_parameter< const int >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(sliding_complexity_seqs_cpp(seqs, windows, overlaps, metric, alph, maxWordSize, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // average_cpp
 double average_cpp(const std::vector<double>& scores, const std::string& type);
 RcppExport SEXP _universalmotif_average_cpp(SEXP scoresSEXP, SEXP typeSEXP) {
@@ -288,29 +323,85 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// enrich_pvals_cpp
+std::vector<double> enrich_pvals_cpp(const std::vector<double>& target_hits, const std::vector<double>& target_total, const std::vector<double>& bkg_hits, const std::vector<double>& bkg_total, const int pseudocount, const int test, const int nthreads);
+RcppExport SEXP _universalmotif_enrich_pvals_cpp(SEXP target_hitsSEXP, SEXP target_totalSEXP, SEXP bkg_hitsSEXP, SEXP bkg_totalSEXP, SEXP pseudocountSEXP, SEXP testSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const std::vector<double>& >::type target_hits(target_hitsSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double>& >::type target_total(target_totalSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double>& >::type bkg_hits(bkg_hitsSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double>& >::type bkg_total(bkg_totalSEXP);
+    Rcpp::traits::input_parameter< const int >::type pseudocount(pseudocountSEXP);
+    Rcpp::traits::input_parameter< const int >::type test(testSEXP);
+    Rcpp::traits::input_parameter< const int >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(enrich_pvals_cpp(target_hits, target_total, bkg_hits, bkg_total, pseudocount, test, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // count_klets_alph_cpp
-std::vector<std::vector<int>> count_klets_alph_cpp(const std::vector<std::string>& sequences, const std::string& alph, const int& k, const int& nthreads);
-RcppExport SEXP _universalmotif_count_klets_alph_cpp(SEXP sequencesSEXP, SEXP alphSEXP, SEXP kSEXP, SEXP nthreadsSEXP) {
+std::vector<std::vector<std::vector<int>>> count_klets_alph_cpp(const std::vector<std::string>& sequences, const std::string& alph, const std::vector<int>& k, const int& nthreads, const bool& merge);
+RcppExport SEXP _universalmotif_count_klets_alph_cpp(SEXP sequencesSEXP, SEXP alphSEXP, SEXP kSEXP, SEXP nthreadsSEXP, SEXP mergeSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::traits::input_parameter< const std::vector<std::string>& >::type sequences(sequencesSEXP);
     Rcpp::traits::input_parameter< const std::string& >::type alph(alphSEXP);
+    Rcpp::traits::input_parameter< const std::vector<int>& >::type k(kSEXP);
+    Rcpp::traits::input_parameter< const int& >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< const bool& >::type merge(mergeSEXP);
+    rcpp_result_gen = Rcpp::wrap(count_klets_alph_cpp(sequences, alph, k, nthreads, merge));
+    return rcpp_result_gen;
+END_RCPP
+}
+// kmer_enrich_cpp
+Rcpp::DataFrame kmer_enrich_cpp(const std::vector<std::string>& sequences, const std::vector<std::string>& bkg_sequences, const std::string& alph, const int& k, const bool& RC, const int& mismatches, const int& ntop, const int& nthreads);
+RcppExport SEXP _universalmotif_kmer_enrich_cpp(SEXP sequencesSEXP, SEXP bkg_sequencesSEXP, SEXP alphSEXP, SEXP kSEXP, SEXP RCSEXP, SEXP mismatchesSEXP, SEXP ntopSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const std::vector<std::string>& >::type sequences(sequencesSEXP);
+    Rcpp::traits::input_parameter< const std::vector<std::string>& >::type bkg_sequences(bkg_sequencesSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type alph(alphSEXP);
     Rcpp::traits::input_parameter< const int& >::type k(kSEXP);
+    Rcpp::traits::input_parameter< const bool& >::type RC(RCSEXP);
+    Rcpp::traits::input_parameter< const int& >::type mismatches(mismatchesSEXP);
+    Rcpp::traits::input_parameter< const int& >::type ntop(ntopSEXP);
     Rcpp::traits::input_parameter< const int& >::type nthreads(nthreadsSEXP);
-    rcpp_result_gen = Rcpp::wrap(count_klets_alph_cpp(sequences, alph, k, nthreads));
+    rcpp_result_gen = Rcpp::wrap(kmer_enrich_cpp(sequences, bkg_sequences, alph, k, RC, mismatches, ntop, nthreads));
     return rcpp_result_gen;
 END_RCPP
 }
-// calc_seq_probs_cpp
-std::vector<double> calc_seq_probs_cpp(const std::vector<std::string>& seqs, const std::vector<double>& bkg, const std::string& alph, const int& nthreads);
-RcppExport SEXP _universalmotif_calc_seq_probs_cpp(SEXP seqsSEXP, SEXP bkgSEXP, SEXP alphSEXP, SEXP nthreadsSEXP) {
+// refine_seeds_cpp
+Rcpp::List refine_seeds_cpp(const std::vector<std::string>& seeds, const std::vector<std::string>& sequences, const std::vector<std::string>& bkg_sequences, const std::string& alph, const std::vector<double>& bkg, const bool& RC, const int& extend, const double& pseudocount, const int& max_iter, const int& nthreads);
+RcppExport SEXP _universalmotif_refine_seeds_cpp(SEXP seedsSEXP, SEXP sequencesSEXP, SEXP bkg_sequencesSEXP, SEXP alphSEXP, SEXP bkgSEXP, SEXP RCSEXP, SEXP extendSEXP, SEXP pseudocountSEXP, SEXP max_iterSEXP, SEXP nthreadsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
-    Rcpp::traits::input_parameter< const std::vector<std::string>& >::type seqs(seqsSEXP);
+    Rcpp::traits::input_parameter< const std::vector<std::string>& >::type seeds(seedsSEXP);
+    Rcpp::traits::input_parameter< const std::vector<std::string>& >::type sequences(sequencesSEXP);
+    Rcpp::traits::input_parameter< const std::vector<std::string>& >::type bkg_sequences(bkg_sequencesSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type alph(alphSEXP);
     Rcpp::traits::input_parameter< const std::vector<double>& >::type bkg(bkgSEXP);
+    Rcpp::traits::input_parameter< const bool& >::type RC(RCSEXP);
+    Rcpp::traits::input_parameter< const int& >::type extend(extendSEXP);
+    Rcpp::traits::input_parameter< const double& >::type pseudocount(pseudocountSEXP);
+    Rcpp::traits::input_parameter< const int& >::type max_iter(max_iterSEXP);
+    Rcpp::traits::input_parameter< const int& >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(refine_seeds_cpp(seeds, sequences, bkg_sequences, alph, bkg, RC, extend, pseudocount, max_iter, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
+// kmer_markov_cpp
+Rcpp::DataFrame kmer_markov_cpp(const std::vector<std::string>& sequences, const std::string& alph, const int& k, const int& order, const bool& RC, const int& ntop, const int& nthreads);
+RcppExport SEXP _universalmotif_kmer_markov_cpp(SEXP sequencesSEXP, SEXP alphSEXP, SEXP kSEXP, SEXP orderSEXP, SEXP RCSEXP, SEXP ntopSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const std::vector<std::string>& >::type sequences(sequencesSEXP);
     Rcpp::traits::input_parameter< const std::string& >::type alph(alphSEXP);
+    Rcpp::traits::input_parameter< const int& >::type k(kSEXP);
+    Rcpp::traits::input_parameter< const int& >::type order(orderSEXP);
+    Rcpp::traits::input_parameter< const bool& >::type RC(RCSEXP);
+    Rcpp::traits::input_parameter< const int& >::type ntop(ntopSEXP);
     Rcpp::traits::input_parameter< const int& >::type nthreads(nthreadsSEXP);
-    rcpp_result_gen = Rcpp::wrap(calc_seq_probs_cpp(seqs, bkg, alph, nthreads));
+    rcpp_result_gen = Rcpp::wrap(kmer_markov_cpp(sequences, alph, k, order, RC, ntop, nthreads));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -325,14 +416,19 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
-// linbin_cpp
-std::vector<double> linbin_cpp(const std::vector<int>& x, const std::vector<int>& gpoints);
-RcppExport SEXP _universalmotif_linbin_cpp(SEXP xSEXP, SEXP gpointsSEXP) {
+// motif_peaks_cpp
+Rcpp::List motif_peaks_cpp(const std::vector<int>& hits, const int seqlen, const double bandwidth, const int peakwidth, const int nrand, const int nthreads, const int seed);
+RcppExport SEXP _universalmotif_motif_peaks_cpp(SEXP hitsSEXP, SEXP seqlenSEXP, SEXP bandwidthSEXP, SEXP peakwidthSEXP, SEXP nrandSEXP, SEXP nthreadsSEXP, SEXP seedSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
-    Rcpp::traits::input_parameter< const std::vector<int>& >::type x(xSEXP);
-    Rcpp::traits::input_parameter< const std::vector<int>& >::type gpoints(gpointsSEXP);
-    rcpp_result_gen = Rcpp::wrap(linbin_cpp(x, gpoints));
+    Rcpp::traits::input_parameter< const std::vector<int>& >::type hits(hitsSEXP);
+    Rcpp::traits::input_parameter< const int >::type seqlen(seqlenSEXP);
+    Rcpp::traits::input_parameter< const double >::type bandwidth(bandwidthSEXP);
+    Rcpp::traits::input_parameter< const int >::type peakwidth(peakwidthSEXP);
+    Rcpp::traits::input_parameter< const int >::type nrand(nrandSEXP);
+    Rcpp::traits::input_parameter< const int >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< const int >::type seed(seedSEXP);
+    rcpp_result_gen = Rcpp::wrap(motif_peaks_cpp(hits, seqlen, bandwidth, peakwidth, nrand, nthreads, seed));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -434,6 +530,42 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// sample_sites_cpp
+std::vector<std::string> sample_sites_cpp(const Rcpp::NumericMatrix& kmat, const int k, const std::vector<std::string>& alph, const int n, const int nthreads, const int seed);
+RcppExport SEXP _universalmotif_sample_sites_cpp(SEXP kmatSEXP, SEXP kSEXP, SEXP alphSEXP, SEXP nSEXP, SEXP nthreadsSEXP, SEXP seedSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const Rcpp::NumericMatrix& >::type kmat(kmatSEXP);
+    Rcpp::traits::input_parameter< const int >::type k(kSEXP);
+    Rcpp::traits::input_parameter< const std::vector<std::string>& >::type alph(alphSEXP);
+    Rcpp::traits::input_parameter< const int >::type n(nSEXP);
+    Rcpp::traits::input_parameter< const int >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< const int >::type seed(seedSEXP);
+    rcpp_result_gen = Rcpp::wrap(sample_sites_cpp(kmat, k, alph, n, nthreads, seed));
+    return rcpp_result_gen;
+END_RCPP
+}
+// implant_sites_cpp
+Rcpp::List implant_sites_cpp(const int seqlen, const int seqnum, const std::vector<std::string>& alph, const int k, const std::vector<double>& freqs, const Rcpp::NumericMatrix& transitions, const Rcpp::List& motifs, const std::vector<double>& rates, const bool rc, const double position_sd, const int nthreads, const int seed);
+RcppExport SEXP _universalmotif_implant_sites_cpp(SEXP seqlenSEXP, SEXP seqnumSEXP, SEXP alphSEXP, SEXP kSEXP, SEXP freqsSEXP, SEXP transitionsSEXP, SEXP motifsSEXP, SEXP ratesSEXP, SEXP rcSEXP, SEXP position_sdSEXP, SEXP nthreadsSEXP, SEXP seedSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const int >::type seqlen(seqlenSEXP);
+    Rcpp::traits::input_parameter< const int >::type seqnum(seqnumSEXP);
+    Rcpp::traits::input_parameter< const std::vector<std::string>& >::type alph(alphSEXP);
+    Rcpp::traits::input_parameter< const int >::type k(kSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double>& >::type freqs(freqsSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::NumericMatrix& >::type transitions(transitionsSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type motifs(motifsSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double>& >::type rates(ratesSEXP);
+    Rcpp::traits::input_parameter< const bool >::type rc(rcSEXP);
+    Rcpp::traits::input_parameter< const double >::type position_sd(position_sdSEXP);
+    Rcpp::traits::input_parameter< const int >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< const int >::type seed(seedSEXP);
+    rcpp_result_gen = Rcpp::wrap(implant_sites_cpp(seqlen, seqnum, alph, k, freqs, transitions, motifs, rates, rc, position_sd, nthreads, seed));
+    return rcpp_result_gen;
+END_RCPP
+}
 // calc_hit_gc
 Rcpp::NumericVector calc_hit_gc(const Rcpp::StringVector& hits, const bool ignoreN);
 RcppExport SEXP _universalmotif_calc_hit_gc(SEXP hitsSEXP, SEXP ignoreNSEXP) {
@@ -483,29 +615,92 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// shuffle_scan_cpp
+Rcpp::List shuffle_scan_cpp(const Rcpp::List& score_mats, const std::vector<std::string>& sequences, const int& k, const std::string& alph, const std::vector<double>& min_scores, const std::vector<int>& mot_index, const int& nmots, const int& shuffle_k, const int& method, const int& reps, const int& nthreads, const int& seed, const bool& no_overlaps, const bool& by_strand);
+RcppExport SEXP _universalmotif_shuffle_scan_cpp(SEXP score_matsSEXP, SEXP sequencesSEXP, SEXP kSEXP, SEXP alphSEXP, SEXP min_scoresSEXP, SEXP mot_indexSEXP, SEXP nmotsSEXP, SEXP shuffle_kSEXP, SEXP methodSEXP, SEXP repsSEXP, SEXP nthreadsSEXP, SEXP seedSEXP, SEXP no_overlapsSEXP, SEXP by_strandSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type score_mats(score_matsSEXP);
+    Rcpp::traits::input_parameter< const std::vector<std::string>& >::type sequences(sequencesSEXP);
+    Rcpp::traits::input_parameter< const int& >::type k(kSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type alph(alphSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double>& >::type min_scores(min_scoresSEXP);
+    Rcpp::traits::input_parameter< const std::vector<int>& >::type mot_index(mot_indexSEXP);
+    Rcpp::traits::input_parameter< const int& >::type nmots(nmotsSEXP);
+    Rcpp::traits::input_parameter< const int& >::type shuffle_k(shuffle_kSEXP);
+    Rcpp::traits::input_parameter< const int& >::type method(methodSEXP);
+    Rcpp::traits::input_parameter< const int& >::type reps(repsSEXP);
+    Rcpp::traits::input_parameter< const int& >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< const int& >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< const bool& >::type no_overlaps(no_overlapsSEXP);
+    Rcpp::traits::input_parameter< const bool& >::type by_strand(by_strandSEXP);
+    rcpp_result_gen = Rcpp::wrap(shuffle_scan_cpp(score_mats, sequences, k, alph, min_scores, mot_index, nmots, shuffle_k, method, reps, nthreads, seed, no_overlaps, by_strand));
+    return rcpp_result_gen;
+END_RCPP
+}
+// count_hits_cpp
+Rcpp::List count_hits_cpp(const Rcpp::List& score_mats, const std::vector<std::string>& sequences, const int& k, const std::string& alph, const std::vector<double>& min_scores, const std::vector<int>& mot_index, const int& nmots, const int& nthreads, const bool& no_overlaps, const bool& by_strand);
+RcppExport SEXP _universalmotif_count_hits_cpp(SEXP score_matsSEXP, SEXP sequencesSEXP, SEXP kSEXP, SEXP alphSEXP, SEXP min_scoresSEXP, SEXP mot_indexSEXP, SEXP nmotsSEXP, SEXP nthreadsSEXP, SEXP no_overlapsSEXP, SEXP by_strandSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type score_mats(score_matsSEXP);
+    Rcpp::traits::input_parameter< const std::vector<std::string>& >::type sequences(sequencesSEXP);
+    Rcpp::traits::input_parameter< const int& >::type k(kSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type alph(alphSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double>& >::type min_scores(min_scoresSEXP);
+    Rcpp::traits::input_parameter< const std::vector<int>& >::type mot_index(mot_indexSEXP);
+    Rcpp::traits::input_parameter< const int& >::type nmots(nmotsSEXP);
+    Rcpp::traits::input_parameter< const int& >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< const bool& >::type no_overlaps(no_overlapsSEXP);
+    Rcpp::traits::input_parameter< const bool& >::type by_strand(by_strandSEXP);
+    rcpp_result_gen = Rcpp::wrap(count_hits_cpp(score_mats, sequences, k, alph, min_scores, mot_index, nmots, nthreads, no_overlaps, by_strand));
+    return rcpp_result_gen;
+END_RCPP
+}
+// scan_centrality_cpp
+Rcpp::List scan_centrality_cpp(const Rcpp::List& score_mats, const std::vector<std::string>& sequences, const int& k, const std::string& alph, const std::vector<double>& min_scores, const std::vector<int>& mot_index, const int& nmots, const int& nbins, const double& central_width, const int& nthreads);
+RcppExport SEXP _universalmotif_scan_centrality_cpp(SEXP score_matsSEXP, SEXP sequencesSEXP, SEXP kSEXP, SEXP alphSEXP, SEXP min_scoresSEXP, SEXP mot_indexSEXP, SEXP nmotsSEXP, SEXP nbinsSEXP, SEXP central_widthSEXP, SEXP nthreadsSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::traits::input_parameter< const Rcpp::List& >::type score_mats(score_matsSEXP);
+    Rcpp::traits::input_parameter< const std::vector<std::string>& >::type sequences(sequencesSEXP);
+    Rcpp::traits::input_parameter< const int& >::type k(kSEXP);
+    Rcpp::traits::input_parameter< const std::string& >::type alph(alphSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double>& >::type min_scores(min_scoresSEXP);
+    Rcpp::traits::input_parameter< const std::vector<int>& >::type mot_index(mot_indexSEXP);
+    Rcpp::traits::input_parameter< const int& >::type nmots(nmotsSEXP);
+    Rcpp::traits::input_parameter< const int& >::type nbins(nbinsSEXP);
+    Rcpp::traits::input_parameter< const double& >::type central_width(central_widthSEXP);
+    Rcpp::traits::input_parameter< const int& >::type nthreads(nthreadsSEXP);
+    rcpp_result_gen = Rcpp::wrap(scan_centrality_cpp(score_mats, sequences, k, alph, min_scores, mot_index, nmots, nbins, central_width, nthreads));
+    return rcpp_result_gen;
+END_RCPP
+}
 // shuffle_markov_cpp
-std::vector<std::string> shuffle_markov_cpp(const std::vector<std::string>& sequences, const int& k, const int& nthreads, const int& seed);
-RcppExport SEXP _universalmotif_shuffle_markov_cpp(SEXP sequencesSEXP, SEXP kSEXP, SEXP nthreadsSEXP, SEXP seedSEXP) {
+std::vector<std::string> shuffle_markov_cpp(const std::vector<std::string>& sequences, const int& k, const int& nthreads, const int& seed, const int& reps);
+RcppExport SEXP _universalmotif_shuffle_markov_cpp(SEXP sequencesSEXP, SEXP kSEXP, SEXP nthreadsSEXP, SEXP seedSEXP, SEXP repsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::traits::input_parameter< const std::vector<std::string>& >::type sequences(sequencesSEXP);
     Rcpp::traits::input_parameter< const int& >::type k(kSEXP);
     Rcpp::traits::input_parameter< const int& >::type nthreads(nthreadsSEXP);
     Rcpp::traits::input_parameter< const int& >::type seed(seedSEXP);
-    rcpp_result_gen = Rcpp::wrap(shuffle_markov_cpp(sequences, k, nthreads, seed));
+    Rcpp::traits::input_parameter< const int& >::type reps(repsSEXP);
+    rcpp_result_gen = Rcpp::wrap(shuffle_markov_cpp(sequences, k, nthreads, seed, reps));
     return rcpp_result_gen;
 END_RCPP
 }
 // shuffle_euler_cpp
-std::vector<std::string> shuffle_euler_cpp(const std::vector<std::string>& sequences, const int& k, const int& nthreads, const int& seed);
-RcppExport SEXP _universalmotif_shuffle_euler_cpp(SEXP sequencesSEXP, SEXP kSEXP, SEXP nthreadsSEXP, SEXP seedSEXP) {
+std::vector<std::string> shuffle_euler_cpp(const std::vector<std::string>& sequences, const int& k, const int& nthreads, const int& seed, const int& reps);
+RcppExport SEXP _universalmotif_shuffle_euler_cpp(SEXP sequencesSEXP, SEXP kSEXP, SEXP nthreadsSEXP, SEXP seedSEXP, SEXP repsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::traits::input_parameter< const std::vector<std::string>& >::type sequences(sequencesSEXP);
     Rcpp::traits::input_parameter< const int& >::type k(kSEXP);
     Rcpp::traits::input_parameter< const int& >::type nthreads(nthreadsSEXP);
     Rcpp::traits::input_parameter< const int& >::type seed(seedSEXP);
-    rcpp_result_gen = Rcpp::wrap(shuffle_euler_cpp(sequences, k, nthreads, seed));
+    Rcpp::traits::input_parameter< const int& >::type reps(repsSEXP);
+    rcpp_result_gen = Rcpp::wrap(shuffle_euler_cpp(sequences, k, nthreads, seed, reps));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -602,6 +797,23 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// create_sequences_fasta_cpp
+void create_sequences_fasta_cpp(const std::string& file, const int seqlen, const int seqnum, const std::vector<std::string>& alph, const int k, const std::vector<double>& freqs, const int nthreads, const int seed, const Rcpp::NumericMatrix& transitions);
+RcppExport SEXP _universalmotif_create_sequences_fasta_cpp(SEXP fileSEXP, SEXP seqlenSEXP, SEXP seqnumSEXP, SEXP alphSEXP, SEXP kSEXP, SEXP freqsSEXP, SEXP nthreadsSEXP, SEXP seedSEXP, SEXP transitionsSEXP) {
+BEGIN_RCPP
+    Rcpp::traits::input_parameter< const std::string& >::type file(fileSEXP);
+    Rcpp::traits::input_parameter< const int >::type seqlen(seqlenSEXP);
+    Rcpp::traits::input_parameter< const int >::type seqnum(seqnumSEXP);
+    Rcpp::traits::input_parameter< const std::vector<std::string>& >::type alph(alphSEXP);
+    Rcpp::traits::input_parameter< const int >::type k(kSEXP);
+    Rcpp::traits::input_parameter< const std::vector<double>& >::type freqs(freqsSEXP);
+    Rcpp::traits::input_parameter< const int >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< const int >::type seed(seedSEXP);
+    Rcpp::traits::input_parameter< const Rcpp::NumericMatrix& >::type transitions(transitionsSEXP);
+    create_sequences_fasta_cpp(file, seqlen, seqnum, alph, k, freqs, nthreads, seed, transitions);
+    return R_NilValue;
+END_RCPP
+}
 // trim_motif_internal
 Rcpp::NumericMatrix trim_motif_internal(const Rcpp::NumericMatrix& motif, const Rcpp::NumericVector& ic_scores, double min_ic, const int trim_from);
 RcppExport SEXP _universalmotif_trim_motif_internal(SEXP motifSEXP, SEXP ic_scoresSEXP, SEXP min_icSEXP, SEXP trim_fromSEXP) {
@@ -991,7 +1203,7 @@ END_RCPP
 }
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_universalmotif_add_multi_cpp", (DL_FUNC) &_universalmotif_add_multi_cpp, 3},
+    {"_universalmotif_add_multi_cpp", (DL_FUNC) &_universalmotif_add_multi_cpp, 4},
     {"_universalmotif_get_alphabet_cpp", (DL_FUNC) &_universalmotif_get_alphabet_cpp, 1},
     {"_universalmotif_calc_wins_cpp2", (DL_FUNC) &_universalmotif_calc_wins_cpp2, 4},
     {"_universalmotif_dust_cpp", (DL_FUNC) &_universalmotif_dust_cpp, 1},
@@ -1001,6 +1213,8 @@ static const R_CallMethodDef CallEntries[] = {
     {"_universalmotif_wootton_federhen_cpp", (DL_FUNC) &_universalmotif_wootton_federhen_cpp, 2},
     {"_universalmotif_slide_windows_cpp", (DL_FUNC) &_universalmotif_slide_windows_cpp, 5},
     {"_universalmotif_sliding_complexity_cpp", (DL_FUNC) &_universalmotif_sliding_complexity_cpp, 7},
+    {"_universalmotif_mask_complexity_cpp", (DL_FUNC) &_universalmotif_mask_complexity_cpp, 9},
+    {"_universalmotif_sliding_complexity_seqs_cpp", (DL_FUNC) &_universalmotif_sliding_complexity_seqs_cpp, 7},
     {"_universalmotif_average_cpp", (DL_FUNC) &_universalmotif_average_cpp, 2},
     {"_universalmotif_compare_motifs_cpp", (DL_FUNC) &_universalmotif_compare_motifs_cpp, 15},
     {"_universalmotif_compare_motifs_all_cpp", (DL_FUNC) &_universalmotif_compare_motifs_all_cpp, 13},
@@ -1009,10 +1223,13 @@ static const R_CallMethodDef CallEntries[] = {
     {"_universalmotif_merge_motifs_cpp", (DL_FUNC) &_universalmotif_merge_motifs_cpp, 11},
     {"_universalmotif_compare_columns_cpp", (DL_FUNC) &_universalmotif_compare_columns_cpp, 7},
     {"_universalmotif_pval_extractor", (DL_FUNC) &_universalmotif_pval_extractor, 11},
-    {"_universalmotif_count_klets_alph_cpp", (DL_FUNC) &_universalmotif_count_klets_alph_cpp, 4},
-    {"_universalmotif_calc_seq_probs_cpp", (DL_FUNC) &_universalmotif_calc_seq_probs_cpp, 4},
+    {"_universalmotif_enrich_pvals_cpp", (DL_FUNC) &_universalmotif_enrich_pvals_cpp, 7},
+    {"_universalmotif_count_klets_alph_cpp", (DL_FUNC) &_universalmotif_count_klets_alph_cpp, 5},
+    {"_universalmotif_kmer_enrich_cpp", (DL_FUNC) &_universalmotif_kmer_enrich_cpp, 8},
+    {"_universalmotif_refine_seeds_cpp", (DL_FUNC) &_universalmotif_refine_seeds_cpp, 10},
+    {"_universalmotif_kmer_markov_cpp", (DL_FUNC) &_universalmotif_kmer_markov_cpp, 7},
     {"_universalmotif_peakfinder_cpp", (DL_FUNC) &_universalmotif_peakfinder_cpp, 2},
-    {"_universalmotif_linbin_cpp", (DL_FUNC) &_universalmotif_linbin_cpp, 2},
+    {"_universalmotif_motif_peaks_cpp", (DL_FUNC) &_universalmotif_motif_peaks_cpp, 7},
     {"_universalmotif_motif_pvalue_cpp", (DL_FUNC) &_universalmotif_motif_pvalue_cpp, 6},
     {"_universalmotif_motif_score_cpp", (DL_FUNC) &_universalmotif_motif_score_cpp, 7},
     {"_universalmotif_branch_and_bound_cpp_exposed", (DL_FUNC) &_universalmotif_branch_and_bound_cpp_exposed, 2},
@@ -1021,12 +1238,17 @@ static const R_CallMethodDef CallEntries[] = {
     {"_universalmotif_paths_to_alph", (DL_FUNC) &_universalmotif_paths_to_alph, 2},
     {"_universalmotif_motif_pvalue_dynamic_single_cpp", (DL_FUNC) &_universalmotif_motif_pvalue_dynamic_single_cpp, 3},
     {"_universalmotif_motif_score_dynamic_single_cpp", (DL_FUNC) &_universalmotif_motif_score_dynamic_single_cpp, 3},
+    {"_universalmotif_sample_sites_cpp", (DL_FUNC) &_universalmotif_sample_sites_cpp, 6},
+    {"_universalmotif_implant_sites_cpp", (DL_FUNC) &_universalmotif_implant_sites_cpp, 12},
     {"_universalmotif_calc_hit_gc", (DL_FUNC) &_universalmotif_calc_hit_gc, 2},
     {"_universalmotif_switch_antisense_coords_cpp", (DL_FUNC) &_universalmotif_switch_antisense_coords_cpp, 1},
     {"_universalmotif_add_gap_dots_cpp", (DL_FUNC) &_universalmotif_add_gap_dots_cpp, 2},
     {"_universalmotif_scan_sequences_cpp", (DL_FUNC) &_universalmotif_scan_sequences_cpp, 8},
-    {"_universalmotif_shuffle_markov_cpp", (DL_FUNC) &_universalmotif_shuffle_markov_cpp, 4},
-    {"_universalmotif_shuffle_euler_cpp", (DL_FUNC) &_universalmotif_shuffle_euler_cpp, 4},
+    {"_universalmotif_shuffle_scan_cpp", (DL_FUNC) &_universalmotif_shuffle_scan_cpp, 14},
+    {"_universalmotif_count_hits_cpp", (DL_FUNC) &_universalmotif_count_hits_cpp, 10},
+    {"_universalmotif_scan_centrality_cpp", (DL_FUNC) &_universalmotif_scan_centrality_cpp, 10},
+    {"_universalmotif_shuffle_markov_cpp", (DL_FUNC) &_universalmotif_shuffle_markov_cpp, 5},
+    {"_universalmotif_shuffle_euler_cpp", (DL_FUNC) &_universalmotif_shuffle_euler_cpp, 5},
     {"_universalmotif_shuffle_seq_local_cpp", (DL_FUNC) &_universalmotif_shuffle_seq_local_cpp, 7},
     {"_universalmotif_shuffle_linear_cpp", (DL_FUNC) &_universalmotif_shuffle_linear_cpp, 4},
     {"_universalmotif_shuffle_k1_cpp", (DL_FUNC) &_universalmotif_shuffle_k1_cpp, 3},
@@ -1034,6 +1256,7 @@ static const R_CallMethodDef CallEntries[] = {
     {"_universalmotif_split_seq_by_win", (DL_FUNC) &_universalmotif_split_seq_by_win, 3},
     {"_universalmotif_get_klets_cpp", (DL_FUNC) &_universalmotif_get_klets_cpp, 2},
     {"_universalmotif_create_sequences_cpp", (DL_FUNC) &_universalmotif_create_sequences_cpp, 8},
+    {"_universalmotif_create_sequences_fasta_cpp", (DL_FUNC) &_universalmotif_create_sequences_fasta_cpp, 9},
     {"_universalmotif_trim_motif_internal", (DL_FUNC) &_universalmotif_trim_motif_internal, 4},
     {"_universalmotif_universalmotif_cpp", (DL_FUNC) &_universalmotif_universalmotif_cpp, 22},
     {"_universalmotif_validObject_universalmotif", (DL_FUNC) &_universalmotif_validObject_universalmotif, 2},
@@ -1,62 +1,97 @@
 #include <Rcpp.h>
-#include <unordered_map>
+#include <RcppThread.h>
 #include "types.h"
 #include "shuffle_sequences.h"
-
-std::vector<std::string> single_to_k(const std::string &seq1,
-    const int &k) {
-
-  vec_str_t out(seq1.size() - k + 1, "");
-  std::size_t counter;
-
-  for (int i = 0; i < k; ++i) {
-    counter = 0;
-    while (counter < out.size()) {
-      out[counter] += seq1[counter + i];
-      ++counter;
+#include "get_bkg.h"
+
+/* Sequences are counted in blocks, each into its own partial count matrix,
+ * which are then summed.
+ *
+ * Timings for 100,000 sites of length 10, k=3 (single thread):
+ *    k-let strings + unordered_map: 44 ms
+ *    rolling k-let indices:          3 ms
+ */
+const std::size_t ADD_MULTI_BLOCK_SIZE = 4096;
+
+/* Count the k-lets starting at each position of equal length sequences:
+ * counts[position][klet]. k-lets with letters outside the alphabet are
+ * skipped. */
+void add_multi_count(const vec_str_t &seqs, const std::size_t from,
+    const std::size_t to, const int k, const std::size_t alphlen,
+    const vec_int_t &lookup, list_int_t &counts) {
+
+  const std::size_t ncol = counts.size();
+  std::size_t top = 1;
+  for (int i = 1; i < k; ++i) top *= alphlen;
+
+  for (std::size_t i = from; i < to; ++i) {
+    const std::string &seq = seqs[i];
+    const std::size_t len = std::min(seq.size(), ncol + k - 1);
+    std::size_t idx = 0;
+    int run = 0;
+    for (std::size_t j = 0; j < len; ++j) {
+      const int l = lookup[(unsigned char)seq[j]];
+      if (l < 0) {
+        run = 0;
+        idx = 0;
+        continue;
+      }
+      if (run == k) {
+        idx -= lookup[(unsigned char)seq[j - k]] * top;
+      } else {
+        ++run;
+      }
+      idx = idx * alphlen + l;
+      if (run == k) counts[j - k + 1][idx]++;
     }
   }
 
-  return out;
-
 }
 
 // [[Rcpp::export(rng = false)]]
 Rcpp::NumericMatrix add_multi_cpp(const std::vector<std::string> &seqs,
-    const int k, const std::vector<std::string> &alph) {
+    const int k, const std::vector<std::string> &alph, const int nthreads = 1) {
 
   std::size_t seqlen = seqs[0].size(), seqnum = seqs.size();
   if (int(seqlen) < k - 1)
     Rcpp::stop("motif is not long enough");
 
-  list_str_t seqs_k(seqnum);
-  for (std::size_t i = 0; i < seqnum; ++i) {
-    seqs_k[i] = single_to_k(seqs[i], k);
+  std::string alph_str;
+  for (std::size_t i = 0; i < alph.size(); ++i) {
+    alph_str += alph[i];
   }
+  const vec_int_t lookup = alph_lookup(alph_str);
+  const std::size_t alphlen = alph.size();
 
   vec_str_t klets = get_klet_strings(alph, k);
+  const std::size_t ncol = seqlen - k + 1;
 
-  std::unordered_map<std::string, int> mklets;
-  mklets.reserve(klets.size());
-  for (std::size_t i = 0; i < klets.size(); ++i) {
-    mklets[klets[i]] = int(i);
-  }
+  std::size_t nblocks = (seqnum + ADD_MULTI_BLOCK_SIZE - 1) / ADD_MULTI_BLOCK_SIZE;
+  list_mat_t block_counts(nblocks, list_int_t(ncol, vec_int_t(klets.size(), 0)));
 
-  Rcpp::NumericMatrix out(klets.size(), int(seqlen) - k + 1);
-  Rcpp::rownames(out) = Rcpp::wrap(klets);
+  RcppThread::parallelFor(0, nblocks,
+      [&seqs, &block_counts, &lookup, k, alphlen, seqnum] (std::size_t b) {
+        add_multi_count(seqs, b * ADD_MULTI_BLOCK_SIZE,
+            std::min(seqnum, (b + 1) * ADD_MULTI_BLOCK_SIZE), k, alphlen,
+            lookup, block_counts[b]);
+      }, nthreads);
 
-  vec_int_t rowsums(out.ncol(), 0);
+  Rcpp::NumericMatrix out(klets.size(), int(ncol));
+  Rcpp::rownames(out) = Rcpp::wrap(klets);
 
-  for (std::size_t i = 0; i < seqs_k.size(); ++i) {
-    for (std::size_t j = 0; j < seqs_k[0].size(); ++j) {
-      out(mklets[seqs_k[i][j]], j) += 1;
-      ++rowsums[j];
+  for (std::size_t i = 0; i < ncol; ++i) {
+    double colsum = 0;
+    for (std::size_t j = 0; j < klets.size(); ++j) {
+      double count = 0;
+      for (std::size_t b = 0; b < nblocks; ++b) {
+        count += block_counts[b][i][j];
+      }
+      out(j, i) = count;
+      colsum += count;
     }
-  }
-
-  for (R_xlen_t i = 0; i < out.ncol(); ++i) {
-    for (R_xlen_t j = 0; j < out.nrow(); ++j) {
-      out(j, i) /= rowsums[i];
+    if (!colsum) continue;
+    for (std::size_t j = 0; j < klets.size(); ++j) {
+      out(j, i) /= colsum;
     }
   }
 
@@ -6,13 +6,15 @@
 #include <map>
 #include <unordered_map>
 #include <numeric>
+#include <cstdint>
 
 // Timings on 20 char string, maxWordSize=7:
 // WF:       3.16 us
 // WF-fast:  2.17 us
-// T:       12.14 us
-// T-fast:  12.14 us
+// T:        1.52 us (12.14 us with std::set<std::string> word counting)
+// T-fast:   1.39 us (12.14 us with std::set<std::string> word counting)
 // DUST:     3.53 us
+// On a 1 Mb string T takes 506 ms (1388 ms before), regardless of maxWordSize.
 
 std::unordered_map<std::string, int> COMPLEXITY_METRICS = {
   {"WoottonFederhen", 1},
@@ -60,14 +62,6 @@ double prod_cpp(const std::vector<double> &x) {
   return y;
 }
 
-double prod_cpp(const int x) {
-  double y = 1;
-  for (double i = 1; i <= double(x); ++i) {
-    y *= i;
-  }
-  return y;
-}
-
 std::vector<double> count_unique_strings(const std::vector<std::string> &y) {
   std::set<std::string> y_unique_s(y.begin(), y.end());
   std::vector<std::string> y_unique(y_unique_s.begin(), y_unique_s.end());
@@ -153,17 +147,105 @@ double dust_cpp(const std::string &x) {
   return std::accumulate(Sa.begin(), Sa.end(), 0.0) / (l - 1.0);
 }
 
+/* Letters in alph are encoded as 0..alph.size()-1, any other characters get
+ * the following codes in order of appearance (WF ignores these, but they
+ * still make distinct words for DUST and Trifonov). */
+std::vector<int> encode_complexity_seq(const std::string &x,
+    const std::string &alph, std::size_t &nlets) {
+  std::vector<int> lookup(256, -1);
+  for (std::size_t i = 0; i < alph.size(); ++i) {
+    lookup[(unsigned char)alph[i]] = int(i);
+  }
+  nlets = alph.size();
+  std::vector<int> out(x.size());
+  for (std::size_t i = 0; i < x.size(); ++i) {
+    int &l = lookup[(unsigned char)x[i]];
+    if (l < 0) l = int(nlets++);
+    out[i] = l;
+  }
+  return out;
+}
+
+/* Suffix array of x (letters 0..nlets-1) by prefix doubling with counting
+ * sorts, O(N log N). An end-of-string sentinel smaller than every letter is
+ * sorted along with the suffixes so that sorting the cyclic shifts of x$ sorts
+ * the suffixes of x. */
+std::vector<std::size_t> suffix_array(const std::vector<int> &x,
+    const std::size_t nlets) {
+  const std::size_t n = x.size() + 1;
+  std::vector<std::size_t> p(n), c(n), pn(n), cn(n);
+  std::vector<std::size_t> cnt(std::max(n, nlets + 1), 0);
+  for (std::size_t i = 0; i < n; ++i) {
+    c[i] = i < x.size() ? std::size_t(x[i]) + 1 : 0;
+    cnt[c[i]]++;
+  }
+  for (std::size_t i = 1; i < cnt.size(); ++i) cnt[i] += cnt[i - 1];
+  for (std::size_t i = n; i-- > 0; ) p[--cnt[c[i]]] = i;
+  std::size_t classes = nlets + 1;
+  for (std::size_t h = 1; h < n; h <<= 1) {
+    for (std::size_t i = 0; i < n; ++i) {
+      pn[i] = p[i] >= h ? p[i] - h : p[i] + n - h;
+    }
+    std::fill(cnt.begin(), cnt.begin() + classes, 0);
+    for (std::size_t i = 0; i < n; ++i) cnt[c[pn[i]]]++;
+    for (std::size_t i = 1; i < classes; ++i) cnt[i] += cnt[i - 1];
+    for (std::size_t i = n; i-- > 0; ) p[--cnt[c[pn[i]]]] = pn[i];
+    cn[p[0]] = 0;
+    classes = 1;
+    for (std::size_t i = 1; i < n; ++i) {
+      const std::size_t a = p[i], b = p[i - 1];
+      if (c[a] != c[b] || c[(a + h) % n] != c[(b + h) % n]) ++classes;
+      cn[a] = classes - 1;
+    }
+    c.swap(cn);
+    if (classes == n) break;
+  }
+  p.erase(p.begin());
+  return p;
+}
+
+/* Number of distinct words of each size 1..maxWordSize in x. Adjacent
+ * suffixes in the suffix array sharing a prefix of length >= w (Kasai et al.
+ * 2001 LCP array) start the same word of size w, so each such pair removes one
+ * of the N-w+1 words from the distinct count. */
+std::vector<double> count_distinct_words(const std::vector<int> &x,
+    const std::size_t nlets, const std::size_t maxWordSize) {
+  const std::size_t n = x.size();
+  const std::vector<std::size_t> sa = suffix_array(x, nlets);
+  std::vector<std::size_t> rank(n);
+  for (std::size_t i = 0; i < n; ++i) rank[sa[i]] = i;
+  /* lcp_ge[w]: number of adjacent pairs with an LCP of exactly w, summed to
+   * at least w below; LCPs above maxWordSize are capped */
+  std::vector<double> lcp_ge(maxWordSize + 2, 0.0);
+  std::size_t h = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    if (rank[i] == 0) {
+      h = 0;
+      continue;
+    }
+    const std::size_t j = sa[rank[i] - 1];
+    while (i + h < n && j + h < n && x[i + h] == x[j + h]) ++h;
+    lcp_ge[std::min(h, maxWordSize + 1)] += 1.0;
+    if (h) --h;
+  }
+  for (std::size_t w = maxWordSize + 1; w-- > 1; ) lcp_ge[w] += lcp_ge[w + 1];
+  std::vector<double> V(maxWordSize);
+  for (std::size_t w = 1; w <= maxWordSize; ++w) {
+    V[w - 1] = double(n - w + 1) - lcp_ge[w];
+  }
+  return V;
+}
+
 // [[Rcpp::export]]
 double trifonov_fast_cpp(const std::string &x, int maxWordSize, std::string alph = "") {
   // And not actually any faster...
   if (!alph.size()) alph = get_alphabet_cpp(x); 
   maxWordSize = std::min(maxWordSize, int(x.size()));
-  std::size_t N = x.size(), K = alph.size();
-  std::vector<double> V(maxWordSize);
+  std::size_t N = x.size(), K = alph.size(), nlets;
+  const std::vector<int> x_ints = encode_complexity_seq(x, alph, nlets);
+  const std::vector<double> V = count_distinct_words(x_ints, nlets, maxWordSize);
   std::vector<double> V_max(maxWordSize);
-  for (std::size_t i = 0; i < V.size(); ++i) {
-    std::vector<std::string> x_split = split_every_n_cpp(x, i + 1);
-    V[i] = double(std::set<std::string>(x_split.begin(), x_split.end()).size());
+  for (std::size_t i = 0; i < V_max.size(); ++i) {
     V_max[i] = std::min(double(std::pow(K, i + 1)), double(N - i));
   }
   return std::accumulate(V.begin(), V.end(), 0.0) / std::accumulate(V_max.begin(), V_max.end(), 0.0);
@@ -173,11 +255,10 @@ double trifonov_fast_cpp(const std::string &x, int maxWordSize, std::string alph
 double trifonov_cpp(const std::string &x, int maxWordSize, std::string alph = "") {
   if (!alph.size()) alph = get_alphabet_cpp(x); 
   maxWordSize = std::min(maxWordSize, int(x.size()));
-  std::size_t N = x.size(), K = alph.size();
-  std::vector<double> CT(maxWordSize);
+  std::size_t N = x.size(), K = alph.size(), nlets;
+  const std::vector<int> x_ints = encode_complexity_seq(x, alph, nlets);
+  std::vector<double> CT = count_distinct_words(x_ints, nlets, maxWordSize);
   for (std::size_t i = 0; i < CT.size(); ++i) {
-    std::vector<std::string> x_split = split_every_n_cpp(x, i + 1);
-    CT[i] = double(std::set<std::string>(x_split.begin(), x_split.end()).size());
     CT[i] /= std::min(double(std::pow(K, i + 1)), double(N - i));
   }
   return prod_cpp(CT);
@@ -198,18 +279,17 @@ double wootton_federhen_fast_cpp(const std::string &x, std::string alph = "") {
 
 // [[Rcpp::export]]
 double wootton_federhen_cpp(const std::string &x, std::string alph = "") {
-  // Stops working for DNA strings length 171+
+  // The multinomial coefficient L! / prod(S!) is computed on the log scale
+  // with lgamma(n + 1) = log(n!), since the factorials themselves overflow
+  // doubles for DNA strings of length 171+.
   if (!alph.size()) alph = get_alphabet_cpp(x); 
   double L = x.size(), N = alph.size();
   const std::vector<double> S = get_complexity_state_vector(x, alph);
-  const double Pi_top = prod_cpp(x.size());
-  std::vector<double> Pi_bot(S.size(), 1);
+  double log_Pi = std::lgamma(L + 1.0);
   for (std::size_t i = 0; i < S.size(); ++i) {
-    if (!S[i]) continue;
-    Pi_bot[i] = prod_cpp(S[i]);
+    log_Pi -= std::lgamma(S[i] + 1.0);
   }
-  double Pi = Pi_top / prod_cpp(Pi_bot);
-  return (log(Pi) / log(N)) / L;
+  return (log_Pi / log(N)) / L;
 }
 
 // [[Rcpp::export]]
@@ -223,52 +303,388 @@ std::vector<std::string> slide_windows_cpp(const std::string &x, const std::size
   return win_strs;
 }
 
-// [[Rcpp::export]]
-std::vector<double> sliding_complexity_cpp(const std::string &x, const std::size_t window, const std::size_t overlap, const std::string metric, std::string alph = "", int maxWordSize = 7, const int nthreads = 1) {
-  if (!alph.size()) alph = get_alphabet_cpp(x);
-  std::vector<std::vector<std::size_t>> wins = calc_wins_cpp2(x.size(), window, overlap);
-  if (!wins.size()) return std::vector<double>();
-  std::vector<double> complexities(wins[0].size());
-  switch (::COMPLEXITY_METRICS[metric]) {
-    case WoottonFederhen: {
-      RcppThread::parallelFor(0, complexities.size(),
-          [&complexities, &x, &wins, &alph] (std::size_t i) {
-            complexities[i] = wootton_federhen_cpp(x.substr(wins[0][i] - 1, wins[1][i] - wins[0][i] + 1), alph);
-          }, nthreads);
-      break;
+/* The sliding versions below move a window over the encoded sequence and only
+ * add the letters/words entering it and remove those leaving it, instead of
+ * recounting every window from scratch. Windows are split into blocks of
+ * about COMPLEXITY_BLOCK_SIZE letters which are run in parallel, each block
+ * starting from empty counts.
+ *
+ * Timings on a 1 Mb DNA string, window=64, overlap=63 (single thread):
+ *    metric    substr     sliding
+ *    WF        1000 ms    64 ms
+ *    WF-fast   850 ms     120 ms
+ *    T         86540 ms   280 ms
+ *    T-fast    86050 ms   410 ms
+ *    DUST      25680 ms   60 ms
+ */
+
+const std::size_t COMPLEXITY_BLOCK_SIZE = 1048576;
+const std::uint64_t COMPLEXITY_DENSE_MAX = 1048576;
+
+std::uint64_t complexity_word(const std::vector<int> &x, const std::size_t p,
+    const std::size_t w, const std::uint64_t nlets) {
+  std::uint64_t code = 0;
+  for (std::size_t i = p; i < p + w; ++i) {
+    code = code * nlets + std::uint64_t(x[i]);
+  }
+  return code;
+}
+
+/* Counts of words which can be added and removed: a dense array when there
+ * are few possible words, otherwise a hash map. */
+struct word_counter_t {
+
+  std::vector<int> dense;
+  std::unordered_map<std::uint64_t, int> sparse;
+  bool is_dense;
+
+  explicit word_counter_t(const double nwords)
+    : is_dense(nwords <= double(COMPLEXITY_DENSE_MAX)) {
+    if (is_dense) dense.assign(std::size_t(nwords), 0);
+  }
+
+  /* returns the count after adding */
+  int add(const std::uint64_t w) {
+    return is_dense ? ++dense[w] : ++sparse[w];
+  }
+
+  /* returns the count before removing */
+  int remove(const std::uint64_t w) {
+    if (is_dense) return dense[w]--;
+    std::unordered_map<std::uint64_t, int>::iterator it = sparse.find(w);
+    if (it->second == 1) {
+      sparse.erase(it);
+      return 1;
     }
-    case WoottonFederhenFast: {
-      RcppThread::parallelFor(0, complexities.size(),
-          [&complexities, &x, &wins, &alph] (std::size_t i) {
-            complexities[i] = wootton_federhen_fast_cpp(x.substr(wins[0][i] - 1, wins[1][i] - wins[0][i] + 1), alph);
-          }, nthreads);
-      break;
+    return it->second--;
+  }
+
+};
+
+/* Move the half-open range [lo, hi) to [new_lo, new_hi), calling remove() for
+ * positions leaving it and add() for those entering it. Both ends only ever
+ * move forward. */
+template <typename A, typename R>
+void slide_range(std::size_t &lo, std::size_t &hi, const std::size_t new_lo,
+    std::size_t new_hi, A add, R remove) {
+  if (new_hi < new_lo) new_hi = new_lo;
+  while (lo < new_lo && lo < hi) remove(lo++);
+  if (lo < new_lo) lo = hi = new_lo;
+  while (hi < new_hi) add(hi++);
+}
+
+void wootton_federhen_sliding(const std::vector<int> &x,
+    const std::size_t nalph, const std::vector<std::size_t> &starts,
+    const std::vector<std::size_t> &stops, const std::size_t from,
+    const std::size_t to, const std::vector<double> &lfact, const bool fast,
+    std::vector<double> &out) {
+  const double N = double(nalph);
+  std::vector<int> counts(nalph, 0);
+  std::size_t lo = starts[from] - 1, hi = lo;
+  for (std::size_t i = from; i < to; ++i) {
+    slide_range(lo, hi, starts[i] - 1, stops[i],
+        [&x, &counts, nalph] (std::size_t p) {
+          if (std::size_t(x[p]) < nalph) counts[x[p]]++;
+        },
+        [&x, &counts, nalph] (std::size_t p) {
+          if (std::size_t(x[p]) < nalph) counts[x[p]]--;
+        });
+    const std::size_t len = stops[i] - starts[i] + 1;
+    double answer = 0, L = double(len);
+    if (fast) {
+      for (std::size_t j = 0; j < nalph; ++j) {
+        if (!counts[j]) continue;
+        const double S = counts[j];
+        answer -= (S / L) * (log(S / L) / log(N));
+      }
+    } else {
+      answer = lfact[len];
+      for (std::size_t j = 0; j < nalph; ++j) {
+        answer -= lfact[counts[j]];
+      }
+      answer = (answer / log(N)) / L;
     }
-    case Trifonov: {
-      if (maxWordSize > int(window)) maxWordSize = int(window);
-      RcppThread::parallelFor(0, complexities.size(),
-          [&complexities, &x, &wins, &alph, &maxWordSize] (std::size_t i) {
-            complexities[i] = trifonov_cpp(x.substr(wins[0][i] - 1, wins[1][i] - wins[0][i] + 1), maxWordSize, alph);
-          }, nthreads);
-      break;
+    out[i] = answer;
+  }
+}
+
+void dust_sliding(const std::vector<int> &x, const std::size_t nlets,
+    const std::vector<std::size_t> &starts, const std::vector<std::size_t> &stops, const std::size_t from,
+    const std::size_t to, std::vector<double> &out) {
+  /* sum of c * (c - 1) / 2 over all triplet counts c */
+  std::uint64_t score = 0;
+  word_counter_t counts(std::pow(double(nlets), 3.0));
+  std::size_t lo = starts[from] - 1, hi = lo;
+  for (std::size_t i = from; i < to; ++i) {
+    const std::size_t len = stops[i] - starts[i] + 1;
+    slide_range(lo, hi, starts[i] - 1, len < 3 ? 0 : stops[i] - 2,
+        [&x, &counts, &score, nlets] (std::size_t p) {
+          score += counts.add(complexity_word(x, p, 3, nlets)) - 1;
+        },
+        [&x, &counts, &score, nlets] (std::size_t p) {
+          score -= counts.remove(complexity_word(x, p, 3, nlets)) - 1;
+        });
+    const double l = double(len) - 2.0;
+    out[i] = double(score) / (l - 1.0);
+  }
+}
+
+void trifonov_sliding(const std::vector<int> &x, const std::size_t nalph,
+    const std::size_t nlets, const std::size_t maxWordSize,
+    const std::vector<std::size_t> &starts, const std::vector<std::size_t> &stops, const std::size_t from,
+    const std::size_t to, const bool fast, std::vector<double> &out) {
+  const double K = double(nalph);
+  std::vector<word_counter_t> counts;
+  std::vector<std::size_t> lo(maxWordSize, starts[from] - 1), hi(lo);
+  std::vector<double> distinct(maxWordSize, 0.0);
+  for (std::size_t w = 0; w < maxWordSize; ++w) {
+    counts.push_back(word_counter_t(std::pow(double(nlets), double(w + 1))));
+  }
+  for (std::size_t i = from; i < to; ++i) {
+    const std::size_t N = stops[i] - starts[i] + 1;
+    const std::size_t mws = std::min(maxWordSize, N);
+    for (std::size_t w = 0; w < maxWordSize; ++w) {
+      word_counter_t &c = counts[w];
+      double &d = distinct[w];
+      slide_range(lo[w], hi[w], starts[i] - 1,
+          stops[i] >= w ? stops[i] - w : 0,
+          [&x, &c, &d, w, nlets] (std::size_t p) {
+            if (c.add(complexity_word(x, p, w + 1, nlets)) == 1) d += 1.0;
+          },
+          [&x, &c, &d, w, nlets] (std::size_t p) {
+            if (c.remove(complexity_word(x, p, w + 1, nlets)) == 1) d -= 1.0;
+          });
     }
-    case TrifonovFast: {
-      if (maxWordSize > int(window)) maxWordSize = int(window);
-      RcppThread::parallelFor(0, complexities.size(),
-          [&complexities, &x, &wins, &alph, &maxWordSize] (std::size_t i) {
-            complexities[i] = trifonov_fast_cpp(x.substr(wins[0][i] - 1, wins[1][i] - wins[0][i] + 1), maxWordSize, alph);
-          }, nthreads);
-      break;
+    if (fast) {
+      double V = 0, V_max = 0;
+      for (std::size_t w = 0; w < mws; ++w) {
+        V += distinct[w];
+        V_max += std::min(double(std::pow(K, w + 1)), double(N - w));
+      }
+      out[i] = V / V_max;
+    } else {
+      double CT = 1;
+      for (std::size_t w = 0; w < mws; ++w) {
+        CT *= distinct[w] / std::min(double(std::pow(K, w + 1)), double(N - w));
+      }
+      out[i] = CT;
     }
-    case DUST: {
+  }
+}
+
+void sliding_complexity_block(const std::string &x, const std::vector<int> &x_ints,
+    const std::size_t nlets, const std::vector<std::vector<std::size_t>> &wins,
+    const std::size_t from, const std::size_t to, const int metric,
+    const std::string &alph, const std::size_t maxWordSize,
+    const std::vector<double> &lfact, std::vector<double> &out) {
+  const std::size_t nalph = alph.size();
+  switch (metric) {
+    case WoottonFederhen:
+    case WoottonFederhenFast:
+      wootton_federhen_sliding(x_ints, nalph, wins[0], wins[1], from, to,
+          lfact, metric == WoottonFederhenFast, out);
+      break;
+    case DUST:
       // Warning: DUST only works for DNA
-      RcppThread::parallelFor(0, complexities.size(),
-          [&complexities, &x, &wins] (std::size_t i) {
-            complexities[i] = dust_cpp(x.substr(wins[0][i] - 1, wins[1][i] - wins[0][i] + 1));
-          }, nthreads);
+      dust_sliding(x_ints, nlets, wins[0], wins[1], from, to, out);
       break;
+    default:
+      if (double(maxWordSize) * std::log2(double(nlets)) >= 64.0) {
+        /* words can't be packed into 64 bit integers, count each window with
+         * its own suffix array instead */
+        for (std::size_t i = from; i < to; ++i) {
+          const std::string xi = x.substr(wins[0][i] - 1, wins[1][i] - wins[0][i] + 1);
+          out[i] = metric == TrifonovFast
+            ? trifonov_fast_cpp(xi, int(maxWordSize), alph)
+            : trifonov_cpp(xi, int(maxWordSize), alph);
+        }
+      } else {
+        trifonov_sliding(x_ints, nalph, nlets, maxWordSize, wins[0], wins[1],
+            from, to, metric == TrifonovFast, out);
+      }
+  }
+}
+
+/* Sliding window complexities of several sequences as out[seq][window]. The
+ * windows of all sequences are split into blocks which are scheduled across
+ * threads together, so many short sequences are as parallel as one long one.
+ * An unknown metric returns no windows. */
+std::vector<std::vector<double>> sliding_complexity_seqs(
+    const std::vector<std::string> &seqs, const std::vector<std::size_t> &windows,
+    const std::vector<std::size_t> &overlaps, const int metric,
+    const std::string &alph, const int maxWordSize, const int nthreads) {
+
+  const std::size_t nseqs = seqs.size();
+  std::vector<std::vector<double>> out(nseqs);
+  if (metric < WoottonFederhen || metric > DUST) return out;
+
+  std::vector<std::vector<std::vector<std::size_t>>> wins(nseqs);
+  std::vector<std::vector<int>> seq_ints(nseqs);
+  std::vector<std::size_t> nlets(nseqs);
+  RcppThread::parallelFor(0, nseqs,
+      [&seqs, &windows, &overlaps, &alph, &wins, &seq_ints, &nlets, &out]
+      (std::size_t i) {
+        wins[i] = calc_wins_cpp2(seqs[i].size(), windows[i], overlaps[i]);
+        if (!wins[i].size()) return;
+        out[i].resize(wins[i][0].size());
+        seq_ints[i] = encode_complexity_seq(seqs[i], alph, nlets[i]);
+      }, nthreads);
+
+  std::size_t max_window = 0;
+  std::vector<std::size_t> block_seq, block_from, block_to;
+  for (std::size_t i = 0; i < nseqs; ++i) {
+    if (!wins[i].size()) continue;
+    max_window = std::max(max_window, windows[i]);
+    const std::vector<std::size_t> &starts = wins[i][0], &stops = wins[i][1];
+    std::size_t from = 0;
+    for (std::size_t j = 1; j < starts.size(); ++j) {
+      if (stops[j] - starts[from] >= COMPLEXITY_BLOCK_SIZE) {
+        block_seq.push_back(i);
+        block_from.push_back(from);
+        block_to.push_back(j);
+        from = j;
+      }
+    }
+    block_seq.push_back(i);
+    block_from.push_back(from);
+    block_to.push_back(starts.size());
+  }
+
+  const std::size_t mws = std::min(std::size_t(maxWordSize), max_window);
+
+  /* log(n!) for every possible window letter count */
+  std::vector<double> lfact;
+  if (metric == WoottonFederhen) {
+    lfact.resize(max_window + 1);
+    for (std::size_t i = 0; i <= max_window; ++i) {
+      lfact[i] = std::lgamma(double(i) + 1.0);
     }
-    default: return std::vector<double>();
   }
-  return complexities;
+
+  RcppThread::parallelFor(0, block_seq.size(),
+      [&seqs, &seq_ints, &nlets, &wins, &block_seq, &block_from, &block_to,
+        &alph, &lfact, &out, metric, mws] (std::size_t b) {
+        const std::size_t i = block_seq[b];
+        sliding_complexity_block(seqs[i], seq_ints[i], nlets[i], wins[i],
+            block_from[b], block_to[b], metric, alph, mws, lfact, out[i]);
+      }, nthreads);
+
+  return out;
+
+}
+
+// [[Rcpp::export]]
+std::vector<double> sliding_complexity_cpp(const std::string &x, const std::size_t window, const std::size_t overlap, const std::string metric, std::string alph = "", int maxWordSize = 7, const int nthreads = 1) {
+  if (!alph.size()) alph = get_alphabet_cpp(x);
+  return sliding_complexity_seqs(std::vector<std::string>(1, x),
+      std::vector<std::size_t>(1, window), std::vector<std::size_t>(1, overlap),
+      ::COMPLEXITY_METRICS[metric], alph, maxWordSize, nthreads)[0];
+}
+
+/* Merge overlapping or adjacent low complexity windows into intervals, as
+ * 1-based [start, stop] pairs. Low complexity means scoring above the
+ * threshold for DUST (higher scores are less complex) and below it for the
+ * other metrics; NaN scores are never masked. */
+std::vector<std::vector<int>> merge_complexity_windows(
+    const std::vector<double> &scores,
+    const std::vector<std::vector<std::size_t>> &wins, const int metric,
+    const double threshold) {
+  std::vector<std::vector<int>> out(2);
+  for (std::size_t i = 0; i < scores.size(); ++i) {
+    const bool low = metric == DUST ? scores[i] > threshold : scores[i] < threshold;
+    if (!low) continue;
+    const int start = int(wins[0][i]), stop = int(wins[1][i]);
+    if (out[0].size() && start <= out[1].back() + 1) {
+      out[1].back() = std::max(out[1].back(), stop);
+    } else {
+      out[0].push_back(start);
+      out[1].push_back(stop);
+    }
+  }
+  return out;
+}
+
+// [[Rcpp::export(rng = false)]]
+Rcpp::List mask_complexity_cpp(const std::vector<std::string> &seqs,
+    const std::vector<std::size_t> &windows, const std::vector<std::size_t> &overlaps,
+    const std::string &metric, const std::string &alph, const int maxWordSize,
+    const double threshold, const std::string &letter, const int nthreads = 1) {
+
+  const int m = ::COMPLEXITY_METRICS[metric];
+  const std::vector<std::vector<double>> scores = sliding_complexity_seqs(seqs,
+      windows, overlaps, m, alph, maxWordSize, nthreads);
+
+  std::vector<std::vector<std::vector<int>>> intervals(seqs.size());
+  std::vector<std::string> masked(letter.size() ? seqs.size() : 0);
+  RcppThread::parallelFor(0, seqs.size(),
+      [&seqs, &windows, &overlaps, &scores, &intervals, &masked, &letter, m,
+        threshold] (std::size_t i) {
+        const std::vector<std::vector<std::size_t>> wins = calc_wins_cpp2(
+            seqs[i].size(), windows[i], overlaps[i]);
+        intervals[i] = wins.size()
+          ? merge_complexity_windows(scores[i], wins, m, threshold)
+          : std::vector<std::vector<int>>(2);
+        if (!letter.size()) return;
+        masked[i] = seqs[i];
+        for (std::size_t j = 0; j < intervals[i][0].size(); ++j) {
+          std::fill(masked[i].begin() + intervals[i][0][j] - 1,
+              masked[i].begin() + intervals[i][1][j], letter[0]);
+        }
+      }, nthreads);
+
+  std::vector<int> seq_index, starts, stops;
+  for (std::size_t i = 0; i < seqs.size(); ++i) {
+    seq_index.insert(seq_index.end(), intervals[i][0].size(), int(i) + 1);
+    starts.insert(starts.end(), intervals[i][0].begin(), intervals[i][0].end());
+    stops.insert(stops.end(), intervals[i][1].begin(), intervals[i][1].end());
+  }
+
+  return Rcpp::List::create(
+      Rcpp::_["sequence"] = seq_index,
+      Rcpp::_["start"] = starts,
+      Rcpp::_["stop"] = stops,
+      Rcpp::_["masked"] = masked
+  );
+
+}
+
+// [[Rcpp::export(rng = false)]]
+Rcpp::List sliding_complexity_seqs_cpp(const std::vector<std::string> &seqs,
+    const std::vector<std::size_t> &windows, const std::vector<std::size_t> &overlaps,
+    const std::string &metric, const std::string &alph, const int maxWordSize,
+    const int nthreads = 1) {
+
+  const std::vector<std::vector<double>> scores = sliding_complexity_seqs(seqs,
+      windows, overlaps, ::COMPLEXITY_METRICS[metric], alph, maxWordSize, nthreads);
+
+  std::size_t n = 0;
+  std::vector<std::size_t> offsets(seqs.size());
+  for (std::size_t i = 0; i < seqs.size(); ++i) {
+    offsets[i] = n;
+    n += scores[i].size();
+  }
+
+  std::vector<int> seq_index(n), starts(n), stops(n);
+  std::vector<double> complexities(n);
+  RcppThread::parallelFor(0, seqs.size(),
+      [&seqs, &windows, &overlaps, &scores, &offsets, &seq_index, &starts,
+        &stops, &complexities] (std::size_t i) {
+        if (!scores[i].size()) return;
+        const std::vector<std::vector<std::size_t>> wins = calc_wins_cpp2(
+            seqs[i].size(), windows[i], overlaps[i]);
+        for (std::size_t j = 0; j < scores[i].size(); ++j) {
+          seq_index[offsets[i] + j] = int(i) + 1;
+          starts[offsets[i] + j] = int(wins[0][j]);
+          stops[offsets[i] + j] = int(wins[1][j]);
+          complexities[offsets[i] + j] = scores[i][j];
+        }
+      }, nthreads);
+
+  return Rcpp::List::create(
+      Rcpp::_["sequence"] = seq_index,
+      Rcpp::_["start"] = starts,
+      Rcpp::_["stop"] = stops,
+      Rcpp::_["complexity"] = complexities
+  );
+
 }
@@ -0,0 +1,243 @@
+#include <Rcpp.h>
+#include <RcppThread.h>
+#include <cmath>
+#include <cfloat>
+#include "types.h"
+#include "enrich_motifs.h"
+
+/* One-sided enrichment tests for the per-motif hit counts of enrich_motifs().
+ *
+ * The point probabilities are computed in log space with Loader's saddle
+ * point expansion (as in R's dbinom() and dhyper()), so they stay accurate
+ * for the very large totals of mode = "total.hits" where differences of
+ * log-gamma functions lose most of their precision. Tails are then summed
+ * away from the mode with the ratio of consecutive terms, stopping once the
+ * terms no longer change the sum.
+ */
+
+const double LN_SQRT_2PI = 0.918938533204672741780329736406;
+const double LN_2PI = 1.837877066409345483560659472811;
+
+enum ENRICH_TESTS {
+  TEST_FISHER   = 1,
+  TEST_BINOMIAL = 2
+};
+
+/* log(n!) - log(sqrt(2 pi n) (n/e)^n) */
+double stirlerr(const double n) {
+
+  const double S0 = 1.0 / 12, S1 = 1.0 / 360, S2 = 1.0 / 1260,
+               S3 = 1.0 / 1680, S4 = 1.0 / 1188;
+
+  if (n <= 15) {
+    return std::lgamma(n + 1) - (n + 0.5) * std::log(n) + n - LN_SQRT_2PI;
+  }
+
+  const double nn = n * n;
+  if (n > 500) return (S0 - S1 / nn) / n;
+  if (n > 80) return (S0 - (S1 - S2 / nn) / nn) / n;
+  if (n > 35) return (S0 - (S1 - (S2 - S3 / nn) / nn) / nn) / n;
+  return (S0 - (S1 - (S2 - (S3 - S4 / nn) / nn) / nn) / nn) / n;
+
+}
+
+/* deviance term x log(x / np) + np - x */
+double bd0(const double x, const double np) {
+
+  if (std::fabs(x - np) < 0.1 * (x + np)) {
+    double v = (x - np) / (x + np);
+    double s = (x - np) * v;
+    double ej = 2 * x * v;
+    v *= v;
+    for (int j = 1; j < 1000; ++j) {
+      ej *= v;
+      const double s1 = s + ej / (2 * j + 1);
+      if (s1 == s) return s1;
+      s = s1;
+    }
+  }
+
+  return x * std::log(x / np) + np - x;
+
+}
+
+/* log of the binomial probability of x successes in n trials */
+double ldbinom(const double x, const double n, const double p, const double q) {
+
+  if (p == 0) return x == 0 ? 0 : -INFINITY;
+  if (q == 0) return x == n ? 0 : -INFINITY;
+  if (x < 0 || x > n) return -INFINITY;
+
+  if (x == 0) {
+    if (n == 0) return 0;
+    return p < 0.1 ? -bd0(n, n * q) - n * p : n * std::log(q);
+  }
+  if (x == n) {
+    return q < 0.1 ? -bd0(n, n * p) - n * q : n * std::log(p);
+  }
+
+  const double lc = stirlerr(n) - stirlerr(x) - stirlerr(n - x)
+    - bd0(x, n * p) - bd0(n - x, n * q);
+  const double lf = LN_2PI + std::log(x) + std::log1p(-x / n);
+
+  return lc - 0.5 * lf;
+
+}
+
+/* log of the probability of drawing x white balls when drawing k balls out
+ * of m white and n black ones */
+double ldhyper(const double x, const double m, const double n, const double k) {
+
+  const double p = k / (m + n), q = (m + n - k) / (m + n);
+
+  return ldbinom(x, m, p, q) + ldbinom(k - x, n, p, q)
+    - ldbinom(k, m + n, p, q);
+
+}
+
+/* log P(X >= a) for a unimodal distribution on lo..hi given the log
+ * probability of a term (lpmf), the ratio of term x + 1 to term x (up) and of
+ * term x - 1 to term x (down). Sums upwards from a if a is past the mode,
+ * otherwise takes the complement of the lower tail below a. */
+template <typename F1, typename F2, typename F3>
+double log_upper_tail(const double a, const double lo, const double hi,
+    const double mode, F1 lpmf, F2 up, F3 down) {
+
+  if (a <= lo) return 0;
+  if (a > hi) return -INFINITY;
+
+  double sum = 1, term = 1;
+
+  if (a > mode) {
+    for (double x = a; x < hi; ++x) {
+      term *= up(x);
+      sum += term;
+      if (term < sum * DBL_EPSILON) break;
+    }
+    return lpmf(a) + std::log(sum);
+  }
+
+  for (double x = a - 1; x > lo; --x) {
+    term *= down(x);
+    sum += term;
+    if (term < sum * DBL_EPSILON) break;
+  }
+  const double lower = std::exp(lpmf(a - 1) + std::log(sum));
+
+  return lower < 1 ? std::log1p(-lower) : -INFINITY;
+
+}
+
+/* one-sided Fisher's exact test for the 2x2 table {{a, b}, {c, d}}:
+ * log P(X >= a) for X ~ hypergeometric(m = a + c, n = b + d, k = a + b) */
+double log_fisher_greater(const double a, const double b, const double c,
+    const double d) {
+
+  const double m = a + c, n = b + d, k = a + b;
+  const double lo = std::max(0.0, k - n), hi = std::min(k, m);
+  const double mode = std::floor((k + 1) * (m + 1) / (m + n + 2));
+
+  return log_upper_tail(a, lo, hi, mode,
+      [m, n, k] (double x) { return ldhyper(x, m, n, k); },
+      [m, n, k] (double x) {
+        return (m - x) * (k - x) / ((x + 1) * (n - k + x + 1));
+      },
+      [m, n, k] (double x) {
+        return x * (n - k + x) / ((m - x + 1) * (k - x + 1));
+      });
+
+}
+
+double fisher_greater(const double a, const double b, const double c,
+    const double d) {
+  return std::exp(log_fisher_greater(a, b, c, d));
+}
+
+double log_binomial_upper(const double x, const double N, const double p) {
+
+  const double q = 1 - p;
+  if (p <= 0) return x <= 0 ? 0 : -INFINITY;
+  if (q <= 0) return 0;
+  const double mode = std::floor((N + 1) * p);
+
+  return log_upper_tail(x, 0, N, mode,
+      [N, p, q] (double i) { return ldbinom(i, N, p, q); },
+      [N, p, q] (double i) { return (N - i) / (i + 1) * p / q; },
+      [N, p, q] (double i) { return i / (N - i + 1) * q / p; });
+
+}
+
+double binomial_upper(const double x, const double N, const double p) {
+  return std::exp(log_binomial_upper(x, N, p));
+}
+
+/* log of the Poisson probability of x events with mean lambda */
+double ldpois(const double x, const double lambda) {
+
+  if (x == 0) return -lambda;
+
+  return -stirlerr(x) - bd0(x, lambda) - 0.5 * (LN_2PI + std::log(x));
+
+}
+
+double log_poisson_upper(const double x, const double lambda) {
+
+  if (lambda <= 0) return x <= 0 ? 0 : -INFINITY;
+
+  return log_upper_tail(x, 0, INFINITY, std::floor(lambda),
+      [lambda] (double i) { return ldpois(i, lambda); },
+      [lambda] (double i) { return lambda / (i + 1); },
+      [lambda] (double i) { return i / lambda; });
+
+}
+
+/* conditional binomial test for the same table: given the a + c hits, the
+ * number of target hits a is binomial with the target share of all
+ * positions, p = (a + b) / (a + b + c + d) */
+double binomial_greater(const double a, const double b, const double c,
+    const double d) {
+
+  return binomial_upper(a, a + c, (a + b) / (a + b + c + d));
+
+}
+
+/* C++ ENTRY ---------------------------------------------------------------- */
+
+// [[Rcpp::export(rng = false)]]
+std::vector<double> enrich_pvals_cpp(const std::vector<double> &target_hits,
+    const std::vector<double> &target_total,
+    const std::vector<double> &bkg_hits, const std::vector<double> &bkg_total,
+    const int pseudocount, const int test, const int nthreads = 1) {
+
+  // The table is made as enrich_motifs() always has: background counts are
+  // scaled to the size of the target set and truncated, and the pseudocount
+  // is added to every cell. Totals can be fractional (mean sequence widths),
+  // in which case the cells are rounded like fisher.test() does.
+
+  std::size_t n = target_hits.size();
+  vec_num_t pvals(n);
+
+  RcppThread::parallelFor(0, n,
+      [&pvals, &target_hits, &target_total, &bkg_hits, &bkg_total,
+       &pseudocount, &test] (std::size_t i) {
+
+        const double norm = target_total[i] / bkg_total[i];
+        const double a = std::round(target_hits[i] + pseudocount);
+        const double b = std::round(target_total[i] - target_hits[i] + pseudocount);
+        const double c = std::trunc(bkg_hits[i] * norm) + pseudocount;
+        const double d = std::trunc((bkg_total[i] - bkg_hits[i]) * norm)
+          + pseudocount;
+
+        if (!(a >= 0 && b >= 0 && c >= 0 && d >= 0)) {
+          pvals[i] = NA_REAL;
+        } else if (test == TEST_BINOMIAL) {
+          pvals[i] = binomial_greater(a, b, c, d);
+        } else {
+          pvals[i] = fisher_greater(a, b, c, d);
+        }
+
+      }, nthreads);
+
+  return pvals;
+
+}
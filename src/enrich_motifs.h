@@ -0,0 +1,20 @@
+#ifndef _ENRICH_MOTIFS_
+#define _ENRICH_MOTIFS_
+
+/* P(X >= x) for X ~ binomial(N, p), accurate far into the tail */
+double binomial_upper(const double x, const double N, const double p);
+
+double log_binomial_upper(const double x, const double N, const double p);
+
+/* log P(X >= x) for X ~ Poisson(lambda) */
+double log_poisson_upper(const double x, const double lambda);
+
+/* one-sided Fisher's exact test of the 2x2 table {{a, b}, {c, d}}, for a
+ * being larger than expected */
+double fisher_greater(const double a, const double b, const double c,
+    const double d);
+
+double log_fisher_greater(const double a, const double b, const double c,
+    const double d);
+
+#endif
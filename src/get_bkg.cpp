@@ -1,68 +1,373 @@
 #include <Rcpp.h>
 #include <RcppThread.h>
-#include <cmath>
+#include <algorithm>
+#include <mutex>
 #include "types.h"
+#include "get_bkg.h"
 
-vec_int_t klet_counter_NA(const vec_int_t &single_seq, const int &k,
-    const std::size_t &nlets, const std::size_t &alphlen) {
+// Timings on a 25 Mb DNA string, single thread (count_klets_alph_cpp,
+// including encoding):
+//          pow() per position   rolling index
+// k=1:      806 ms              214 ms
+// k=2:     1219 ms              224 ms
+// k=3:     1903 ms              191 ms
+// k=4:     2683 ms              188 ms
+// k=5:     3226 ms              201 ms
+// k=6:     4023 ms              191 ms
+// k=1:6   13860 ms (six calls)  427 ms (single pass)
 
-  vec_int_t klet_counts(nlets, 0);
-  int l, counter;
+/* k-lets are counted in blocks of this many positions, each with its own
+ * count array, so that a few long sequences are still split across threads */
+const std::size_t KLET_BLOCK_SIZE = 1048576;
 
-  for (std::size_t i = 0; i < single_seq.size() - k + 1; ++i) {
-    l = 0; counter = 0;
-    for (int j = k - 1; j >= 0; --j) {
-      l += pow(alphlen, j) * single_seq[i + counter];
-      ++counter;
+vec_int_t alph_lookup(const std::string &alph) {
+
+  vec_int_t lookup(256, -1);
+  for (std::size_t i = 0; i < alph.size(); ++i) {
+    lookup[(unsigned char)alph[i]] = i;
+  }
+
+  return lookup;
+
+}
+
+void encode_seq_alph(const std::string &single_seq, const vec_int_t &lookup,
+    vec_int_t &seq_ints) {
+
+  seq_ints.resize(single_seq.size());
+  for (std::size_t i = 0; i < single_seq.size(); ++i) {
+    seq_ints[i] = lookup[(unsigned char)single_seq[i]];
+  }
+
+}
+
+std::size_t klet_count_ints(const vec_int_t &seq_ints,
+    const std::size_t &start, const std::size_t &len, const int &k,
+    const std::size_t &alphlen, vec_int_t &klet_counts) {
+
+  // Adds the counts of the k-lets of seq_ints[start, start + len) to
+  // klet_counts (alphlen^k entries). The k-let index is rolled along by
+  // dropping the leading letter, so there is no pow() or modulo per position.
+  // Negative letters are non-standard: k-lets containing them are skipped.
+  // Returns the index of the last (k-1)-let.
+
+  std::size_t mlets = 1;
+  for (int i = 0; i < k - 1; ++i) mlets *= alphlen;
+
+  std::size_t l = 0, kl;
+  int run = 0, x;
+  for (std::size_t i = start; i < start + len; ++i) {
+    x = seq_ints[i];
+    if (x < 0) {
+      run = 0;
+      l = 0;
+    } else if (run < k - 1) {
+      l = l * alphlen + x;
+      ++run;
+    } else {
+      kl = l * alphlen + x;
+      ++klet_counts[kl];
+      l = kl - seq_ints[i - k + 1] * mlets;
     }
+  }
+
+  return l;
 
-    if (l >= 0) ++klet_counts[l];
-    // Un-comment this line if you decide to use remainder count in probability
-    // calculations.
-    // else ++klet_counts[nlets];
+}
+
+template <typename F>
+void klet_roll_multi(const vec_int_t &seq_ints, const std::size_t &start,
+    const std::size_t &len, const std::size_t &count_from, const vec_int_t &ks,
+    const std::size_t &alphlen, F add) {
+
+  // All k in ks at once, with one rolling index per k; add(j, index) is
+  // called for every k-let ending at or after count_from, so that
+  // overlapping blocks do not count anything twice.
+
+  std::size_t nk = ks.size();
+  int kmax = *std::max_element(ks.begin(), ks.end());
+
+  std::vector<std::size_t> lead(nk, 1), l(nk, 0);
+  for (std::size_t j = 0; j < nk; ++j) {
+    for (int i = 0; i < ks[j] - 1; ++i) lead[j] *= alphlen;
+  }
 
+  int run = 0, x;
+  for (std::size_t i = start; i < start + len; ++i) {
+    x = seq_ints[i];
+    if (x < 0) {
+      run = 0;
+      std::fill(l.begin(), l.end(), 0);
+      continue;
+    }
+    for (std::size_t j = 0; j < nk; ++j) {
+      if (run >= ks[j])
+        l[j] = (l[j] - seq_ints[i - ks[j]] * lead[j]) * alphlen + x;
+      else
+        l[j] = l[j] * alphlen + x;
+    }
+    if (run < kmax) ++run;
+    if (i < count_from) continue;
+    for (std::size_t j = 0; j < nk; ++j) {
+      if (run >= ks[j]) add(j, l[j]);
+    }
   }
 
-  return klet_counts;
+}
+
+void klet_count_ints_multi(const vec_int_t &seq_ints,
+    const std::size_t &start, const std::size_t &len,
+    const std::size_t &count_from, const vec_int_t &ks,
+    const std::size_t &alphlen, list_int_t &klet_counts) {
+
+  klet_roll_multi(seq_ints, start, len, count_from, ks, alphlen,
+      [&klet_counts] (const std::size_t &j, const std::size_t &kl) {
+        ++klet_counts[j][kl];
+      });
 
 }
 
-vec_int_t klet_counter_with_alph(const str_t &single_seq, const str_t &alph,
-    const int &k) {
+std::size_t klet_hash_t::capacity(const std::size_t &expected) {
 
-  std::size_t alphlen = alph.size();
-  std::size_t nlets = pow(alphlen, k);
+  std::size_t cap = 16;
+  while (cap < 2 * expected) cap *= 2;
+  return cap;
 
-  // For a string with 25 million characters, about 150 ms can be saved by using
-  // char indexing on an int array. However, I'm not sure how to deal with
-  // non-ASCII chars in that case. Maybe don't bother. Either way for k < 5 the
-  // output is returned in less than a second.
-  vec_int_t seq_ints(single_seq.size(), -1000000);
-  for (std::size_t i = 0; i < single_seq.size(); ++i) {
-    for (std::size_t a = 0; a < alphlen; ++a) {
-      if (single_seq[i] == alph[a]) {
-        seq_ints[i] = a;
-        break;
-      }
+}
+
+klet_hash_t::klet_hash_t(const std::size_t &expected) {
+
+  std::size_t cap = capacity(expected);
+  keys.assign(cap, KLET_HASH_EMPTY);
+  counts.assign(cap, 0);
+  mask = cap - 1;
+
+}
+
+void klet_hash_t::add(const std::uint64_t &key) {
+
+  // open addressing with linear probing; capacity is at least twice the
+  // number of k-lets that can be added, so the table never fills up
+  std::size_t i = (key * 0x9E3779B97F4A7C15ULL >> 20) & mask;
+  while (keys[i] != key && keys[i] != KLET_HASH_EMPTY) i = (i + 1) & mask;
+  keys[i] = key;
+  ++counts[i];
+
+}
+
+list_mat_t klet_count_seqs(const list_int_t &seq_ints, const vec_int_t &ks,
+    const std::size_t &alphlen, const int &nthreads) {
+
+  // counts[sequence][k][klet]
+
+  std::size_t nk = ks.size();
+  int kmax = *std::max_element(ks.begin(), ks.end());
+
+  list_int_t empty(nk);
+  for (std::size_t j = 0; j < nk; ++j) {
+    std::size_t nlets = 1;
+    for (int i = 0; i < ks[j]; ++i) nlets *= alphlen;
+    empty[j].assign(nlets, 0);
+  }
+
+  list_mat_t counts(seq_ints.size(), empty);
+
+  /* blocks are defined by k-let end positions and rescan the kmax - 1
+   * preceding letters, so that no k-let is lost or counted twice */
+  vec_int_t block_seq, block_start;
+  for (std::size_t i = 0; i < seq_ints.size(); ++i) {
+    for (std::size_t j = 0; j < seq_ints[i].size(); j += KLET_BLOCK_SIZE) {
+      block_seq.push_back(i);
+      block_start.push_back(j);
     }
   }
 
-  vec_int_t counts = klet_counter_NA(seq_ints, k, nlets, alphlen);
+  if (block_seq.size() <= seq_ints.size()) {
+
+    RcppThread::parallelFor(0, seq_ints.size(),
+        [&counts, &seq_ints, &ks, &alphlen] (std::size_t i) {
+          klet_count_ints_multi(seq_ints[i], 0, seq_ints[i].size(), 0, ks,
+              alphlen, counts[i]);
+        }, nthreads);
+
+  } else {
+
+    list_mat_t block_counts(block_seq.size());
+    RcppThread::parallelFor(0, block_seq.size(),
+        [&block_counts, &block_seq, &block_start, &seq_ints, &ks, &alphlen,
+         &kmax, &empty] (std::size_t b) {
+          const vec_int_t &seq = seq_ints[block_seq[b]];
+          std::size_t from = block_start[b];
+          std::size_t to = std::min(from + KLET_BLOCK_SIZE, seq.size());
+          std::size_t scan_from = from < std::size_t(kmax - 1) ? 0 : from - kmax + 1;
+          block_counts[b] = empty;
+          klet_count_ints_multi(seq, scan_from, to - scan_from, from, ks,
+              alphlen, block_counts[b]);
+        }, nthreads);
+
+    for (std::size_t b = 0; b < block_seq.size(); ++b) {
+      for (std::size_t j = 0; j < nk; ++j) {
+        vec_int_t &c = counts[block_seq[b]][j];
+        for (std::size_t h = 0; h < c.size(); ++h) {
+          c[h] += block_counts[b][j][h];
+        }
+      }
+      list_int_t().swap(block_counts[b]);
+    }
+
+  }
 
   return counts;
 
 }
 
+list_int_t klet_count_merged(const list_int_t &seq_ints, const vec_int_t &ks,
+    const std::size_t &alphlen, const int &nthreads) {
+
+  // Summed counts of all sequences: out[k][klet]. Sequences (or blocks of
+  // long sequences) are grouped into batches of about KLET_BLOCK_SIZE
+  // letters. Each batch counts into its own table, which is a dense array
+  // unless alphlen^k is larger than the number of letters in the batch (e.g.
+  // amino acids with k > 4), in which case an open addressing hash table is
+  // used instead. Batch tables are added to the output as soon as they are
+  // done, so no per-sequence count arrays are kept.
+
+  std::size_t nk = ks.size();
+  int kmax = *std::max_element(ks.begin(), ks.end());
+
+  std::vector<std::size_t> nlets(nk, 1);
+  for (std::size_t j = 0; j < nk; ++j) {
+    for (int i = 0; i < ks[j]; ++i) nlets[j] *= alphlen;
+  }
+
+  list_int_t out(nk);
+  for (std::size_t j = 0; j < nk; ++j) {
+    out[j].assign(nlets[j], 0);
+  }
+
+  vec_int_t block_seq, block_start;
+  for (std::size_t i = 0; i < seq_ints.size(); ++i) {
+    for (std::size_t j = 0; j < seq_ints[i].size(); j += KLET_BLOCK_SIZE) {
+      block_seq.push_back(i);
+      block_start.push_back(j);
+    }
+  }
+
+  vec_int_t batch_first(1, 0);
+  std::size_t letters = 0;
+  for (std::size_t b = 0; b < block_seq.size(); ++b) {
+    letters += std::min(KLET_BLOCK_SIZE,
+        seq_ints[block_seq[b]].size() - block_start[b]);
+    if (letters >= KLET_BLOCK_SIZE || b == block_seq.size() - 1) {
+      batch_first.push_back(b + 1);
+      letters = 0;
+    }
+  }
+  std::size_t nbatches = batch_first.size() - 1;
+
+  std::mutex out_mutex;
+
+  RcppThread::parallelFor(0, nbatches,
+      [&out, &out_mutex, &batch_first, &block_seq, &block_start, &seq_ints,
+       &ks, &nk, &kmax, &nlets, &alphlen] (std::size_t b) {
+
+        std::size_t letters = 0;
+        for (int u = batch_first[b]; u < batch_first[b + 1]; ++u) {
+          letters += std::min(KLET_BLOCK_SIZE,
+              seq_ints[block_seq[u]].size() - block_start[u]);
+        }
+
+        /* a hash table is only used when the dense counts would take well
+         * over the memory of its slots (a key and a count each) */
+        const std::size_t hash_bytes = klet_hash_t::capacity(letters)
+          * (sizeof(std::uint64_t) + sizeof(int));
+
+        vec_bool_t sparse(nk);
+        list_int_t dense(nk);
+        std::vector<klet_hash_t> hashed;
+        hashed.reserve(nk);
+        for (std::size_t j = 0; j < nk; ++j) {
+          sparse[j] = nlets[j] * sizeof(int) > 2 * hash_bytes;
+          if (sparse[j])
+            hashed.push_back(klet_hash_t(letters));
+          else
+            hashed.push_back(klet_hash_t(0));
+          if (!sparse[j]) dense[j].assign(nlets[j], 0);
+        }
+
+        for (int u = batch_first[b]; u < batch_first[b + 1]; ++u) {
+          const vec_int_t &seq = seq_ints[block_seq[u]];
+          std::size_t from = block_start[u];
+          std::size_t to = std::min(from + KLET_BLOCK_SIZE, seq.size());
+          std::size_t scan_from = from < std::size_t(kmax - 1) ? 0 : from - kmax + 1;
+          klet_roll_multi(seq, scan_from, to - scan_from, from, ks, alphlen,
+              [&sparse, &dense, &hashed] (const std::size_t &j,
+                const std::size_t &kl) {
+                if (sparse[j])
+                  hashed[j].add(kl);
+                else
+                  ++dense[j][kl];
+              });
+        }
+
+        std::lock_guard<std::mutex> lock(out_mutex);
+        for (std::size_t j = 0; j < nk; ++j) {
+          if (sparse[j]) {
+            for (std::size_t h = 0; h < hashed[j].keys.size(); ++h) {
+              if (hashed[j].keys[h] != KLET_HASH_EMPTY)
+                out[j][hashed[j].keys[h]] += hashed[j].counts[h];
+            }
+          } else {
+            for (std::size_t h = 0; h < nlets[j]; ++h) {
+              out[j][h] += dense[j][h];
+            }
+          }
+        }
+
+      }, nthreads);
+
+  return out;
+
+}
+
 // [[Rcpp::export(rng = false)]]
-std::vector<std::vector<int>> count_klets_alph_cpp(const std::vector<std::string> &sequences,
-    const std::string &alph, const int &k, const int &nthreads) {
+std::vector<std::vector<std::vector<int>>> count_klets_alph_cpp(
+    const std::vector<std::string> &sequences, const std::string &alph,
+    const std::vector<int> &k, const int &nthreads, const bool &merge = false) {
 
-  list_int_t counts(sequences.size());
+  // Counts for every k in one pass over the sequences: out[k][sequence].
+  // Letters not in alph are ignored. If merge = true, each out[k] holds a
+  // single vector with the summed counts of all sequences.
+
+  vec_int_t lookup = alph_lookup(alph);
+
+  list_int_t seq_ints(sequences.size());
   RcppThread::parallelFor(0, sequences.size(),
-      [&counts, &sequences, &k, &alph] (std::size_t i) {
-        counts[i] = klet_counter_with_alph(sequences[i], alph, k);
+      [&seq_ints, &sequences, &lookup] (std::size_t i) {
+        encode_seq_alph(sequences[i], lookup, seq_ints[i]);
       }, nthreads);
 
-  return counts;
+  list_mat_t out(k.size());
+
+  if (merge) {
+    list_int_t counts = klet_count_merged(seq_ints, k, alph.size(), nthreads);
+    for (std::size_t j = 0; j < k.size(); ++j) {
+      out[j].resize(1);
+      out[j][0].swap(counts[j]);
+    }
+    return out;
+  }
+
+  list_mat_t counts = klet_count_seqs(seq_ints, k, alph.size(), nthreads);
+  list_int_t().swap(seq_ints);
+
+  for (std::size_t j = 0; j < k.size(); ++j) {
+    out[j].resize(counts.size());
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+      out[j][i].swap(counts[i][j]);
+    }
+  }
+
+  return out;
 
 }
@@ -0,0 +1,42 @@
+#ifndef _GET_BKG_
+#define _GET_BKG_
+
+#include <cstdint>
+#include "types.h"
+
+const std::uint64_t KLET_HASH_EMPTY = UINT64_MAX;
+
+/* k-let index -> count, for when alphlen^k dense counters would be mostly
+ * empty; unused slots have key KLET_HASH_EMPTY */
+struct klet_hash_t {
+  std::vector<std::uint64_t> keys;
+  vec_int_t counts;
+  std::size_t mask;
+  explicit klet_hash_t(const std::size_t &expected);
+  void add(const std::uint64_t &key);
+  /* number of slots used for up to `expected` distinct k-lets */
+  static std::size_t capacity(const std::size_t &expected);
+};
+
+/* 256-entry char table: letter index in alph, or -1 */
+vec_int_t alph_lookup(const std::string &alph);
+
+void encode_seq_alph(const std::string &single_seq, const vec_int_t &lookup,
+    vec_int_t &seq_ints);
+
+std::size_t klet_count_ints(const vec_int_t &seq_ints,
+    const std::size_t &start, const std::size_t &len, const int &k,
+    const std::size_t &alphlen, vec_int_t &klet_counts);
+
+void klet_count_ints_multi(const vec_int_t &seq_ints,
+    const std::size_t &start, const std::size_t &len,
+    const std::size_t &count_from, const vec_int_t &ks,
+    const std::size_t &alphlen, list_int_t &klet_counts);
+
+list_int_t klet_count_merged(const list_int_t &seq_ints, const vec_int_t &ks,
+    const std::size_t &alphlen, const int &nthreads);
+
+list_mat_t klet_count_seqs(const list_int_t &seq_ints, const vec_int_t &ks,
+    const std::size_t &alphlen, const int &nthreads);
+
+#endif
@@ -1,61 +1,663 @@
 #include <Rcpp.h>
 #include <RcppThread.h>
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <numeric>
+#include <limits>
+#include <cmath>
 #include "types.h"
 #include "utils-internal.h"
 #include "shuffle_sequences.h"
+#include "enrich_motifs.h"
+#include "scan_sequences.h"
+#include "get_bkg.h"
 
-vec_int_t seq_string_to_int(const str_t &seq1, const str_t &alph,
-    const std::size_t &alphlen) {
+/* k-mers are packed two bits per letter (A, C, G, T/U = 0..3), first letter
+ * in the highest bits, so the reverse complement of letter x is 3 - x. Counts
+ * are kept in dense arrays of 4^k entries, hence the limit on k. */
+typedef std::uint32_t kmer_t;
+typedef std::vector<kmer_t> vec_kmer_t;
 
-  vec_int_t out(seq1.size());
-  for (std::size_t i = 0; i < seq1.size(); ++i) {
-    for (std::size_t a = 0; a < alphlen; ++a) {
-      if (seq1[i] == alph[a]) {
-        out[i] = a;
-        break;
+const int KMER_MAX_K = 12;
+const int KMER_STAMP_MAX_K = 10;
+const std::size_t KMER_FLUSH_SIZE = 64;
+const int NO_HIT = std::numeric_limits<int>::min();
+
+kmer_t kmer_rc(kmer_t kmer, const int &k) {
+
+  kmer_t rc = 0;
+  for (int i = 0; i < k; ++i) {
+    rc = (rc << 2) | (3 - (kmer & 3));
+    kmer >>= 2;
+  }
+
+  return rc;
+
+}
+
+std::string kmer_string(kmer_t kmer, const int &k, const std::string &alph) {
+
+  std::string out(k, ' ');
+  for (int i = k - 1; i >= 0; --i) {
+    out[i] = alph[kmer & 3];
+    kmer >>= 2;
+  }
+
+  return out;
+
+}
+
+/* Distinct k-mers of one sequence. Duplicates are dropped as they are added
+ * by stamping each k-mer with the sequence, unless 4^k is too large for a
+ * stamp array (then the k-mers are sorted once all have been added). */
+struct kmer_set_t {
+
+  vec_kmer_t kmers, stamps;
+  kmer_t tag;
+  bool RC;
+
+  kmer_set_t(const int &k, const bool &RC_) : tag(0), RC(RC_) {
+    if (k <= KMER_STAMP_MAX_K) stamps.assign(std::size_t(1) << 2 * k, 0);
+  }
+
+  void clear() {
+    kmers.clear();
+    if (++tag == 0) {
+      std::fill(stamps.begin(), stamps.end(), 0);
+      tag = 1;
+    }
+  }
+
+  void add(const kmer_t &kmer, const kmer_t &rc) {
+    const kmer_t x = RC ? std::min(kmer, rc) : kmer;
+    if (stamps.empty()) {
+      kmers.push_back(x);
+    } else if (stamps[x] != tag) {
+      stamps[x] = tag;
+      kmers.push_back(x);
+    }
+  }
+
+  void finish() {
+    if (!stamps.empty()) return;
+    std::sort(kmers.begin(), kmers.end());
+    kmers.erase(std::unique(kmers.begin(), kmers.end()), kmers.end());
+  }
+
+};
+
+/* add all k-mers within `mismatches` substitutions of kmer, excluding itself
+ * (substitutions are only made from position `from` onwards, so every
+ * neighbour is generated once); rc is the reverse complement of kmer, which
+ * changes by the same XOR at the mirrored position */
+void kmer_neighbours(const kmer_t &kmer, const kmer_t &rc, const int &k,
+    const int &from, const int &mismatches, kmer_set_t &out) {
+
+  for (int i = from; i < k; ++i) {
+    const int shift = 2 * (k - 1 - i);
+    const kmer_t letter = (kmer >> shift) & 3;
+    for (kmer_t alt = 0; alt < 4; ++alt) {
+      if (alt == letter) continue;
+      const kmer_t neighbour = kmer ^ ((letter ^ alt) << shift);
+      const kmer_t neighbour_rc = rc ^ ((letter ^ alt) << 2 * i);
+      out.add(neighbour, neighbour_rc);
+      if (mismatches > 1) {
+        kmer_neighbours(neighbour, neighbour_rc, k, i + 1, mismatches - 1,
+            out);
       }
     }
   }
 
-  return out;
+}
+
+/* The distinct k-mers of a sequence (or k-mers within `mismatches` of one
+ * found in it), reverse complements collapsed to the smaller of the pair if
+ * RC. k-mers with letters outside the alphabet are skipped. */
+void seq_kmers(const std::string &seq, const vec_int_t &lookup, const int &k,
+    const int &mismatches, kmer_set_t &out, vec_kmer_t &tmp) {
+
+  const kmer_t mask = (kmer_t(1) << 2 * k) - 1;
+
+  tmp.clear();
+  kmer_t kmer = 0;
+  int valid = 0;
+  for (std::size_t i = 0; i < seq.size(); ++i) {
+    const int letter = lookup[(unsigned char)seq[i]];
+    if (letter < 0) {
+      valid = 0;
+      continue;
+    }
+    kmer = ((kmer << 2) | letter) & mask;
+    if (++valid >= k) tmp.push_back(kmer);
+  }
+  std::sort(tmp.begin(), tmp.end());
+  tmp.erase(std::unique(tmp.begin(), tmp.end()), tmp.end());
+
+  out.clear();
+  for (std::size_t i = 0; i < tmp.size(); ++i) {
+    const kmer_t rc = kmer_rc(tmp[i], k);
+    out.add(tmp[i], rc);
+    if (mismatches > 0) kmer_neighbours(tmp[i], rc, k, 0, mismatches, out);
+  }
+  out.finish();
 
 }
 
-double calc_seq_prob(const str_t &seq1, const vec_num_t &bkg,
-    const str_t &alph, const std::size_t &alphlen) {
+/* number of sequences containing each k-mer */
+std::vector<std::uint32_t> count_seq_kmers(const vec_str_t &sequences,
+    const std::string &alph, const int &k, const bool &RC,
+    const int &mismatches, const int &nthreads) {
+
+  // Each batch of sequences collects the distinct k-mers of every sequence
+  // and adds them to the shared counts every KMER_FLUSH_SIZE sequences.
+  // There are only a few batches per thread, since each one sets up a
+  // kmer_set_t (with a 4^k stamp array for k <= KMER_STAMP_MAX_K).
 
-  vec_int_t seq1i = seq_string_to_int(seq1, alph, alphlen);
-  double out = 1;
-  for (std::size_t i = 0; i < seq1.size(); ++i) {
-    out *= bkg[seq1i[i]];
+  std::size_t nseqs = sequences.size();
+  std::vector<std::uint32_t> counts(std::size_t(1) << 2 * k, 0);
+
+  vec_int_t lookup(256, -1);
+  for (int i = 0; i < 4; ++i) {
+    lookup[(unsigned char)alph[i]] = i;
   }
+
+  std::size_t batch_size = parallel_batch_size(nseqs, nthreads, nseqs);
+  std::size_t nbatches = (nseqs + batch_size - 1) / batch_size;
+  std::mutex counts_mutex;
+
+  RcppThread::parallelFor(0, nbatches,
+      [&counts, &counts_mutex, &sequences, &lookup, &nseqs, &k, &RC,
+       &mismatches, &batch_size] (std::size_t b) {
+
+        kmer_set_t kmers(k, RC);
+        vec_kmer_t tmp, batch;
+        std::size_t first = b * batch_size;
+        std::size_t last = std::min((b + 1) * batch_size, nseqs);
+        for (std::size_t i = first; i < last; ++i) {
+          seq_kmers(sequences[i], lookup, k, mismatches, kmers, tmp);
+          batch.insert(batch.end(), kmers.kmers.begin(), kmers.kmers.end());
+          if ((i - first + 1) % KMER_FLUSH_SIZE == 0 || i == last - 1) {
+            std::lock_guard<std::mutex> lock(counts_mutex);
+            for (std::size_t j = 0; j < batch.size(); ++j) {
+              ++counts[batch[j]];
+            }
+            batch.clear();
+          }
+        }
+
+      }, nthreads);
+
+  return counts;
+
+}
+
+/* Best hit of a motif in every sequence: score is NO_HIT for sequences
+ * shorter than the motif, and minus is 1 for hits of the reverse
+ * complement. */
+struct best_hits_t {
+  vec_int_t score, minus;
+  std::vector<std::size_t> start;
+};
+
+list_int_t encode_scan_seqs(const vec_str_t &sequences,
+    const std::string &alph, const int &nthreads) {
+
+  vec_int_t lookup(256, 4);
+  for (int i = 0; i < 4; ++i) {
+    lookup[(unsigned char)alph[i]] = i;
+  }
+
+  list_int_t out(sequences.size());
+  RcppThread::parallelFor(0, sequences.size(),
+      [&out, &sequences, &lookup] (std::size_t i) {
+        vec_int_t seq_ints(sequences[i].size());
+        for (std::size_t j = 0; j < seq_ints.size(); ++j) {
+          seq_ints[j] = lookup[(unsigned char)sequences[i][j]];
+        }
+        klet_indices_NA(seq_ints, out[i], 1, 4);
+      }, nthreads);
+
   return out;
+
 }
 
-//------------------------------------------------------------------------------
+/* log2(p / bkg), times 1000 as integers as for scanning, column by column */
+vec_int_t ppm_to_pwm_flat(const vec_num_t &ppm, const vec_num_t &bkg) {
 
-// // [[Rcpp::export(rng = false)]]
-// Rcpp::List motif_finder_no_bkg_cpp(const std::vector<std::string> &sequences,
-//     const std::string &alph, const int &nmotifs, const double &pvalue,
-//     const int &minsize, const int &maxsize, const int &nthreads) {
-//
-//
-//
-// }
+  vec_int_t pwm(ppm.size());
+  for (std::size_t i = 0; i < ppm.size(); ++i) {
+    pwm[i] = ppm[i] > 0 ? std::log2(ppm[i] / bkg[i % 4]) * 1000 : -999999;
+  }
 
-// [[Rcpp::export(rng = false)]]
-std::vector<double> calc_seq_probs_cpp(const std::vector<std::string> &seqs,
-    const std::vector<double> &bkg, const std::string &alph,
+  return pwm;
+
+}
+
+vec_int_t pwm_flat_rc(const vec_int_t &pwm) {
+
+  const std::size_t width = pwm.size() / 4;
+  vec_int_t rc(pwm.size());
+  for (std::size_t j = 0; j < width; ++j) {
+    for (int a = 0; a < 4; ++a) {
+      rc[j * 4 + a] = pwm[(width - 1 - j) * 4 + 3 - a];
+    }
+  }
+
+  return rc;
+
+}
+
+void scan_best_hits(const list_int_t &seqs, const vec_int_t &pwm,
+    const vec_int_t &pwm_rc, const bool &RC, best_hits_t &hits,
     const int &nthreads) {
 
-  std::size_t alphlen = alph.size();
+  const std::size_t width = pwm.size() / 4;
+  hits.score.assign(seqs.size(), NO_HIT);
+  hits.minus.assign(seqs.size(), 0);
+  hits.start.assign(seqs.size(), 0);
 
-  vec_num_t probs(seqs.size());
   RcppThread::parallelFor(0, seqs.size(),
-      [&probs, &seqs, &bkg, &alph, &alphlen] (std::size_t i) {
-        probs[i] = calc_seq_prob(seqs[i], bkg, alph, alphlen);
+      [&hits, &seqs, &pwm, &pwm_rc, &RC, &width] (std::size_t i) {
+        int score;
+        std::size_t start;
+        if (!scan_best_hit(pwm, width, 4, seqs[i], score, start)) return;
+        hits.score[i] = score;
+        hits.start[i] = start;
+        if (RC && scan_best_hit(pwm_rc, width, 4, seqs[i], score, start) &&
+            score > hits.score[i]) {
+          hits.score[i] = score;
+          hits.start[i] = start;
+          hits.minus[i] = 1;
+        }
+      }, nthreads);
+
+}
+
+/* The score threshold for which the best hits are most enriched in the
+ * target sequences (one-sided Fisher's exact test on the number of
+ * sequences with a hit), trying the score of every target hit. Returns the
+ * log P-value. */
+double best_threshold(const best_hits_t &target, const best_hits_t &bkg,
+    int &threshold, double &ntarget_hits, double &nbkg_hits) {
+
+  const double ntarget = target.score.size(), nbkg = bkg.score.size();
+
+  vec_int_t tscores, bscores;
+  for (std::size_t i = 0; i < target.score.size(); ++i) {
+    if (target.score[i] != NO_HIT) tscores.push_back(target.score[i]);
+  }
+  for (std::size_t i = 0; i < bkg.score.size(); ++i) {
+    if (bkg.score[i] != NO_HIT) bscores.push_back(bkg.score[i]);
+  }
+  std::sort(tscores.begin(), tscores.end(), std::greater<int>());
+  std::sort(bscores.begin(), bscores.end(), std::greater<int>());
+
+  double best = 0;
+  threshold = NO_HIT;
+  ntarget_hits = nbkg_hits = 0;
+  std::size_t c = 0;
+  for (std::size_t a = 0; a < tscores.size(); ++a) {
+    if (a + 1 < tscores.size() && tscores[a + 1] == tscores[a]) continue;
+    while (c < bscores.size() && bscores[c] >= tscores[a]) ++c;
+    const double logp = log_fisher_greater(a + 1, ntarget - a - 1, c,
+        nbkg - c);
+    if (logp < best) {
+      best = logp;
+      threshold = tscores[a];
+      ntarget_hits = a + 1;
+      nbkg_hits = c;
+    }
+  }
+
+  return best;
+
+}
+
+/* PPM from the target hits scoring at least threshold, in the motif
+ * orientation, with the pseudocount spread according to the background */
+vec_num_t sites_to_ppm(const list_int_t &seqs, const best_hits_t &hits,
+    const int &threshold, const std::size_t &width, const vec_num_t &bkg,
+    const double &pseudocount) {
+
+  vec_num_t counts(width * 4, 0);
+  double nsites = 0;
+  for (std::size_t i = 0; i < seqs.size(); ++i) {
+    if (hits.score[i] == NO_HIT || hits.score[i] < threshold) continue;
+    ++nsites;
+    for (std::size_t j = 0; j < width; ++j) {
+      int letter;
+      if (hits.minus[i])
+        letter = 3 - seqs[i][hits.start[i] + width - 1 - j];
+      else
+        letter = seqs[i][hits.start[i] + j];
+      if (letter >= 0 && letter < 4) ++counts[j * 4 + letter];
+    }
+  }
+
+  for (std::size_t i = 0; i < counts.size(); ++i) {
+    counts[i] = (counts[i] + pseudocount * bkg[i % 4]) / (nsites + pseudocount);
+  }
+
+  return counts;
+
+}
+
+/* Refines one seed (see refine_seeds_cpp()), returning the log P-value of
+ * the best motif, which is left in ppm (4 x width, column by column). */
+double refine_seed(const std::string &seed, const list_int_t &target,
+    const list_int_t &background, const vec_int_t &lookup,
+    const vec_num_t &bkg, const bool &RC, const int &extend,
+    const double &pseudocount, const int &max_iter, const int &nthreads,
+    vec_num_t &ppm, double &nsites, double &bkg_sites, int &threshold,
+    int &iterations) {
+
+  const std::size_t width = seed.size() + 2 * extend;
+  vec_num_t next(width * 4);
+  for (std::size_t j = 0; j < width; ++j) {
+    const int letter = j < std::size_t(extend) || j >= width - extend ? -1
+      : lookup[(unsigned char)seed[j - extend]];
+    for (int a = 0; a < 4; ++a) {
+      if (letter < 0)
+        next[j * 4 + a] = bkg[a];
+      else
+        next[j * 4 + a] = ((a == letter) + pseudocount * bkg[a])
+          / (1 + pseudocount);
+    }
+  }
+
+  best_hits_t target_hits, bkg_hits;
+  double best_logp = 0;
+  ppm = next;
+  nsites = bkg_sites = 0;
+  threshold = NO_HIT;
+  iterations = 0;
+
+  while (iterations < max_iter) {
+
+    ++iterations;
+    const vec_int_t pwm = ppm_to_pwm_flat(next, bkg);
+    const vec_int_t pwm_rc = pwm_flat_rc(pwm);
+    scan_best_hits(target, pwm, pwm_rc, RC, target_hits, nthreads);
+    scan_best_hits(background, pwm, pwm_rc, RC, bkg_hits, nthreads);
+
+    int t;
+    double a, c;
+    const double logp = best_threshold(target_hits, bkg_hits, t, a, c);
+    if (iterations > 1 && logp >= best_logp) break;
+
+    ppm = next;
+    best_logp = logp;
+    threshold = t;
+    nsites = a;
+    bkg_sites = c;
+
+    if (a == 0) break;
+    next = sites_to_ppm(target, target_hits, t, width, bkg, pseudocount);
+
+  }
+
+  return best_logp;
+
+}
+
+/* Probability of k-mer w under the order m Markov model with (m + 1)-let
+ * counts mcounts (nmlets in total), where prefix[u] is the number of
+ * (m + 1)-lets starting with the m-let u (see kmer_markov_cpp()) */
+double markov_kmer_prob(const kmer_t &w, const int &k, const int &order,
+    const vec_int_t &mcounts, const vec_num_t &prefix, const double &nmlets) {
+
+  const kmer_t mmask = (kmer_t(1) << 2 * (order + 1)) - 1;
+  const int lead = 2 * (k - order - 1);
+
+  double p = mcounts[w >> lead] / nmlets;
+  for (int shift = lead - 2; shift >= 0 && p > 0; shift -= 2) {
+    const kmer_t mlet = (w >> shift) & mmask;
+    p *= prefix[mlet >> 2] > 0 ? mcounts[mlet] / prefix[mlet >> 2] : 0;
+  }
+
+  return p;
+
+}
+
+//------------------------------------------------------------------------------
+
+// [[Rcpp::export(rng = false)]]
+Rcpp::DataFrame kmer_enrich_cpp(const std::vector<std::string> &sequences,
+    const std::vector<std::string> &bkg_sequences, const std::string &alph,
+    const int &k, const bool &RC, const int &mismatches, const int &ntop,
+    const int &nthreads) {
+
+  // Seeds for de novo motif discovery: the k-mers found in more target than
+  // background sequences, ranked by one-sided Fisher's exact test on the
+  // number of sequences containing each k-mer (or a k-mer within
+  // `mismatches` of it). Only the ntop best k-mers are returned. With RC,
+  // every k-mer stands for itself and its reverse complement.
+
+  const double ntarget = sequences.size(), nbkg = bkg_sequences.size();
+
+  std::vector<std::uint32_t> target = count_seq_kmers(sequences, alph, k, RC,
+      mismatches, nthreads);
+  std::vector<std::uint32_t> bkg = count_seq_kmers(bkg_sequences, alph, k, RC,
+      mismatches, nthreads);
+
+  vec_kmer_t candidates;
+  for (std::size_t i = 0; i < target.size(); ++i) {
+    if (target[i] > 0 && target[i] / ntarget > bkg[i] / nbkg) {
+      candidates.push_back(i);
+    }
+  }
+
+  vec_num_t logp(candidates.size());
+  RcppThread::parallelFor(0, candidates.size(),
+      [&logp, &candidates, &target, &bkg, &ntarget, &nbkg] (std::size_t i) {
+        const double a = target[candidates[i]], c = bkg[candidates[i]];
+        logp[i] = log_fisher_greater(a, ntarget - a, c, nbkg - c);
       }, nthreads);
 
-  return probs;
+  std::vector<std::size_t> order(candidates.size());
+  std::iota(order.begin(), order.end(), 0);
+  const std::size_t nout = std::min(order.size(), std::size_t(ntop));
+  std::partial_sort(order.begin(), order.begin() + nout, order.end(),
+      [&logp, &candidates, &target] (std::size_t x, std::size_t y) {
+        if (logp[x] != logp[y]) return logp[x] < logp[y];
+        return target[candidates[x]] > target[candidates[y]];
+      });
+
+  vec_str_t kmers(nout);
+  vec_num_t target_hits(nout), bkg_hits(nout), log10_pval(nout);
+  for (std::size_t i = 0; i < nout; ++i) {
+    const kmer_t kmer = candidates[order[i]];
+    kmers[i] = kmer_string(kmer, k, alph);
+    target_hits[i] = target[kmer];
+    bkg_hits[i] = bkg[kmer];
+    log10_pval[i] = logp[order[i]] / std::log(10.0);
+  }
+
+  return Rcpp::DataFrame::create(
+        Rcpp::_["kmer"] = kmers,
+        Rcpp::_["target.seq.hits"] = target_hits,
+        Rcpp::_["bkg.seq.hits"] = bkg_hits,
+        Rcpp::_["log10.pval"] = log10_pval,
+        Rcpp::_["stringsAsFactors"] = false
+      );
+
+}
+
+// [[Rcpp::export(rng = false)]]
+Rcpp::List refine_seeds_cpp(const std::vector<std::string> &seeds,
+    const std::vector<std::string> &sequences,
+    const std::vector<std::string> &bkg_sequences, const std::string &alph,
+    const std::vector<double> &bkg, const bool &RC, const int &extend,
+    const double &pseudocount, const int &max_iter, const int &nthreads) {
+
+  // Seeds (k-mers) are turned into PWMs by alternating between scanning and
+  // rebuilding the motif, as in hard EM with at most one site per sequence:
+  //
+  //   1. Scan the targets and background for the best hit per sequence.
+  //   2. Pick the score threshold for which the sequences with hits are
+  //      most enriched in the targets (best_threshold()).
+  //   3. Rebuild the PPM from the target hits above the threshold.
+  //
+  // The starting motif is the seed padded with `extend` background columns
+  // on each side, so the flanks are learnt from the sites. This stops once
+  // the enrichment P-value no longer improves or after max_iter rounds, and
+  // the motif with the best P-value is kept. The sequences are only encoded
+  // once; all scanning is done in parallel.
+
+  list_int_t target = encode_scan_seqs(sequences, alph, nthreads);
+  list_int_t background = encode_scan_seqs(bkg_sequences, alph, nthreads);
+
+  vec_int_t lookup(256, -1);
+  for (int i = 0; i < 4; ++i) {
+    lookup[(unsigned char)alph[i]] = i;
+  }
+
+  Rcpp::List motifs(seeds.size());
+  vec_num_t nsites(seeds.size()), bkg_sites(seeds.size()),
+            log10_pval(seeds.size()), thresholds(seeds.size()),
+            iterations(seeds.size());
+
+  for (std::size_t s = 0; s < seeds.size(); ++s) {
+
+    vec_num_t ppm;
+    int threshold, iters;
+    const double logp = refine_seed(seeds[s], target, background, lookup, bkg,
+        RC, extend, pseudocount, max_iter, nthreads, ppm, nsites[s],
+        bkg_sites[s], threshold, iters);
+
+    const std::size_t width = ppm.size() / 4;
+    Rcpp::NumericMatrix mat(4, width);
+    for (std::size_t j = 0; j < width; ++j) {
+      for (int a = 0; a < 4; ++a) {
+        mat(a, j) = ppm[j * 4 + a];
+      }
+    }
+    motifs[s] = mat;
+    log10_pval[s] = logp / std::log(10.0);
+    thresholds[s] = threshold == NO_HIT ? NA_REAL : threshold / 1000.0;
+    iterations[s] = iters;
+
+  }
+
+  return Rcpp::List::create(
+        Rcpp::_["motifs"] = motifs,
+        Rcpp::_["target.seq.hits"] = nsites,
+        Rcpp::_["bkg.seq.hits"] = bkg_sites,
+        Rcpp::_["log10.pval"] = log10_pval,
+        Rcpp::_["threshold"] = thresholds,
+        Rcpp::_["iterations"] = iterations
+      );
+
+}
+
+// [[Rcpp::export(rng = false)]]
+Rcpp::DataFrame kmer_markov_cpp(const std::vector<std::string> &sequences,
+    const std::string &alph, const int &k, const int &order, const bool &RC,
+    const int &ntop, const int &nthreads) {
+
+  // Over-represented k-mers without background sequences: the expected
+  // count of every k-mer w comes from an order m Markov model estimated from
+  // the (m + 1)-let counts C of the target sequences themselves,
+  //
+  //   E(w) = N * C(w[1..m+1]) / sum(C) * prod_i C(w[i-m..i]) / C(w[i-m..i-1]*)
+  //
+  // for i from m + 2 to k, where N is the total number of k-mers and
+  // C(u*) the number of (m + 1)-lets starting with u (markov_kmer_prob()).
+  // The observed counts are compared to these with a Poisson test, and only
+  // the ntop best over-represented k-mers are returned, along with the
+  // number of sequences containing them. With RC, every k-mer is pooled
+  // with its reverse complement.
+
+  const vec_int_t lookup = alph_lookup(alph);
+  list_int_t seq_ints(sequences.size());
+  RcppThread::parallelFor(0, sequences.size(),
+      [&seq_ints, &sequences, &lookup] (std::size_t i) {
+        encode_seq_alph(sequences[i], lookup, seq_ints[i]);
+      }, nthreads);
+
+  const vec_int_t ks = {order + 1, k};
+  const list_int_t counts = klet_count_merged(seq_ints, ks, 4, nthreads);
+  list_int_t().swap(seq_ints);
+  const vec_int_t &mcounts = counts[0], &kcounts = counts[1];
+
+  vec_num_t prefix(mcounts.size() / 4, 0);
+  double nmlets = 0, nklets = 0;
+  for (std::size_t i = 0; i < mcounts.size(); ++i) {
+    prefix[i / 4] += mcounts[i];
+    nmlets += mcounts[i];
+  }
+  for (std::size_t i = 0; i < kcounts.size(); ++i) {
+    nklets += kcounts[i];
+  }
+
+  vec_kmer_t candidates;
+  vec_num_t observed;
+  for (kmer_t w = 0; w < kcounts.size(); ++w) {
+    if (kcounts[w] == 0) continue;
+    const kmer_t rc = RC ? kmer_rc(w, k) : w;
+    if (rc < w && kcounts[rc] > 0) continue;
+    const kmer_t x = std::min(w, rc);
+    candidates.push_back(x);
+    observed.push_back(rc == w ? kcounts[w] : kcounts[w] + kcounts[rc]);
+  }
+
+  const std::vector<std::uint32_t> seq_counts = count_seq_kmers(sequences,
+      alph, k, RC, 0, nthreads);
+
+  vec_num_t expected(candidates.size()), logp(candidates.size());
+  RcppThread::parallelFor(0, candidates.size(),
+      [&expected, &logp, &candidates, &observed, &mcounts, &prefix, &nmlets,
+       &nklets, &k, &order, &RC] (std::size_t i) {
+
+        const kmer_t w = candidates[i];
+        const kmer_t rc = RC ? kmer_rc(w, k) : w;
+
+        double e = nklets * markov_kmer_prob(w, k, order, mcounts, prefix,
+            nmlets);
+        if (rc != w) {
+          e += nklets * markov_kmer_prob(rc, k, order, mcounts, prefix,
+              nmlets);
+        }
+
+        expected[i] = e;
+        logp[i] = log_poisson_upper(observed[i], e);
+
+      }, nthreads);
+
+  std::vector<std::size_t> order_i;
+  for (std::size_t i = 0; i < candidates.size(); ++i) {
+    if (observed[i] > expected[i]) order_i.push_back(i);
+  }
+  const std::size_t nout = std::min(order_i.size(), std::size_t(ntop));
+  std::partial_sort(order_i.begin(), order_i.begin() + nout, order_i.end(),
+      [&logp, &observed] (std::size_t x, std::size_t y) {
+        if (logp[x] != logp[y]) return logp[x] < logp[y];
+        return observed[x] > observed[y];
+      });
+
+  vec_str_t kmers(nout);
+  vec_num_t target_hits(nout), target_seq_hits(nout), expected_hits(nout),
+            zscores(nout), log10_pval(nout);
+  for (std::size_t i = 0; i < nout; ++i) {
+    const std::size_t j = order_i[i];
+    kmers[i] = kmer_string(candidates[j], k, alph);
+    target_hits[i] = observed[j];
+    target_seq_hits[i] = seq_counts[candidates[j]];
+    expected_hits[i] = expected[j];
+    zscores[i] = expected[j] > 0
+      ? (observed[j] - expected[j]) / std::sqrt(expected[j]) : R_PosInf;
+    log10_pval[i] = logp[j] / std::log(10.0);
+  }
+
+  return Rcpp::DataFrame::create(
+        Rcpp::_["kmer"] = kmers,
+        Rcpp::_["target.hits"] = target_hits,
+        Rcpp::_["target.seq.hits"] = target_seq_hits,
+        Rcpp::_["expected.hits"] = expected_hits,
+        Rcpp::_["z.score"] = zscores,
+        Rcpp::_["log10.pval"] = log10_pval,
+        Rcpp::_["stringsAsFactors"] = false
+      );
 
 }
@@ -1,65 +1,323 @@
 #include <Rcpp.h>
+#include <RcppThread.h>
+#include <cmath>
+#include <complex>
+#include <algorithm>
 #include "types.h"
+#include "rng.h"
 
-int peakfinder_single_cpp(int i, const Rcpp::NumericVector &x, int m) {
+/* Motif position peaks: binned Gaussian kernel density (modified from
+ * KernSmooth::bkde, Wand 2015) and local maxima, for the real hits and for
+ * nrand sets of random hits making up the null distribution of peak heights.
+ *
+ * The convolution is done with FFTs of length P (a power of two). The kernel
+ * transform is the same for all replicates, so it is only made once. It is
+ * also real, so two replicates are smoothed at once as the real and imaginary
+ * parts of one forward and one inverse FFT. Replicates are split into
+ * blocks of PEAKS_BLOCK_SIZE sharing the working buffers; replicate r uses
+ * random stream r, and the peak height moments are combined in block order,
+ * so results do not depend on the number of threads.
+ *
+ * Timings for seq.length = 1000, 600 hits, bandwidth = 20 (single thread):
+ *    nrand = 100:     12 ms
+ *    nrand = 10,000: 0.7 s
+ */
 
-  int z = i - m;
-  if (z < 0) z = 0;
+const std::size_t PEAKS_BLOCK_SIZE = 64;
+const double DENSITY_NOISE = 1e-10;
 
-  int w = i + m;
-  if (w > x.size() - 1) w = x.size() - 1;
+typedef std::complex<double> cplx_t;
+typedef std::vector<cplx_t> vec_cplx_t;
 
-  Rcpp::IntegerVector x1 = Rcpp::seq(z, i);
-  Rcpp::IntegerVector x2 = Rcpp::seq(i, w);
+/* in-place iterative radix-2 FFT; twiddles[j] = exp(-2 pi i j / n), j < n/2.
+ * The inverse is not scaled by 1/n. */
+void fft_radix2(vec_cplx_t &a, const vec_cplx_t &twiddles, const bool inverse) {
 
-  Rcpp::NumericVector x_1 = x[x1];
-  Rcpp::NumericVector x_2 = x[x2];
+  const std::size_t n = a.size();
 
-  if (Rcpp::is_true(Rcpp::all(x_1 <= x[i])) && Rcpp::is_true(Rcpp::all(x_2 <= x[i])))
-    return i + 1;
-  else
-    return NA_INTEGER;
+  for (std::size_t i = 1, j = 0; i < n; ++i) {
+    std::size_t bit = n >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) std::swap(a[i], a[j]);
+  }
+
+  /* std::complex is guaranteed to be laid out as {real, imag}; the products
+   * are written out since operator* checks for NaN/Inf */
+  double *d = reinterpret_cast<double *>(a.data());
+  for (std::size_t len = 2; len <= n; len <<= 1) {
+    const std::size_t half = len / 2, step = n / len;
+    for (std::size_t j = 0; j < half; ++j) {
+      const double wr = twiddles[j * step].real();
+      const double wi = inverse ? -twiddles[j * step].imag()
+                                : twiddles[j * step].imag();
+      for (std::size_t i = j; i < n; i += len) {
+        double *u = d + 2 * i, *v = d + 2 * (i + half);
+        const double xr = v[0] * wr - v[1] * wi, xi = v[0] * wi + v[1] * wr;
+        v[0] = u[0] - xr;
+        v[1] = u[1] - xi;
+        u[0] += xr;
+        u[1] += xi;
+      }
+    }
+  }
 
 }
 
-// [[Rcpp::export(rng = false)]]
-Rcpp::IntegerVector peakfinder_cpp(const Rcpp::NumericVector &x, int m = 3) {
+struct kde_t {
+
+  std::size_t M, P;
+  vec_cplx_t twiddles;
+  vec_num_t kernel;
+
+  /* grid points 1..M (gridsize = range.x = seqlen in kern_fun()), n hits */
+  kde_t(const std::size_t &seqlen, const double &bandwidth, const std::size_t &n)
+    : M(seqlen) {
+
+    const double tau = 4, a = 1, b = M;
+    const double delta = (b - a) / (bandwidth * (M - 1.0));
+    const std::size_t L = std::min(std::size_t(std::floor(tau / delta)), M);
+
+    P = 1;
+    while (P < M + L + 1) P <<= 1;
+
+    twiddles.resize(P / 2);
+    for (std::size_t j = 0; j < P / 2; ++j) {
+      twiddles[j] = std::polar(1.0, -2.0 * M_PI * double(j) / double(P));
+    }
+
+    vec_num_t kappa(L + 1);
+    double tot = 0;
+    for (std::size_t l = 0; l <= L; ++l) {
+      const double z = double(l) * delta;
+      kappa[l] = std::exp(-0.5 * z * z) / std::sqrt(2.0 * M_PI)
+        / (double(n) * bandwidth);
+      tot += l == 0 ? kappa[l] : 2.0 * kappa[l];
+    }
+    tot *= (b - a) / (M - 1.0) * double(n);
 
-  Rcpp::IntegerVector shape = Rcpp::diff(Rcpp::sign(Rcpp::diff(x)));
+    vec_cplx_t k(P, 0.0);
+    k[0] = kappa[0] / tot;
+    for (std::size_t l = 1; l <= L; ++l) {
+      k[l] = kappa[l] / tot;
+      k[P - l] = kappa[l] / tot;
+    }
+    fft_radix2(k, twiddles, false);
 
-  Rcpp::IntegerVector shape_count = Rcpp::seq(0, shape.size() - 1);
-  Rcpp::IntegerVector shape_which = shape_count[shape < 0];
+    /* the kernel is symmetric, so its transform is real */
+    kernel.resize(P);
+    for (std::size_t i = 0; i < P; ++i) kernel[i] = k[i].real();
 
-  Rcpp::IntegerVector pks(shape_which.size());
+  }
 
-  for (R_xlen_t i = 0; i < shape_which.size(); ++i) {
-    pks[i] = peakfinder_single_cpp(shape_which[i] + 1, x, m);
+  /* Far from any hits the density is zero plus FFT rounding errors, which
+   * would otherwise show up as spurious peaks */
+  static void remove_noise(vec_num_t &y) {
+    double top = 0;
+    for (std::size_t i = 0; i < y.size(); ++i) top = std::max(top, y[i]);
+    const double eps = top * DENSITY_NOISE;
+    for (std::size_t i = 0; i < y.size(); ++i) {
+      if (y[i] < eps) y[i] = 0;
+    }
   }
 
-  return pks[!is_na(pks)];
+  /* hits -> density at grid points 1..M; work must have size P. Since the
+   * kernel transform is real, a second set of hits (hits2, if not NULL) can
+   * be binned into the imaginary part and smoothed with the same FFTs. */
+  void density(const int *hits, const int *hits2, const std::size_t &n,
+      vec_cplx_t &work, vec_num_t &y, vec_num_t &y2) const {
 
-}
+    /* linear binning with delta = 1: hits at 1 or M are dropped, as in
+     * KernSmooth::linbin() */
+    std::fill(work.begin(), work.end(), cplx_t(0.0, 0.0));
+    for (std::size_t i = 0; i < n; ++i) {
+      if (hits[i] > 1 && std::size_t(hits[i]) < M) {
+        work[hits[i] - 1] += 1.0;
+      }
+    }
+    if (hits2 != NULL) {
+      for (std::size_t i = 0; i < n; ++i) {
+        if (hits2[i] > 1 && std::size_t(hits2[i]) < M) {
+          work[hits2[i] - 1] += cplx_t(0.0, 1.0);
+        }
+      }
+    }
 
-// [[Rcpp::export(rng = false)]]
-std::vector<double> linbin_cpp(const std::vector<int> &x, const std::vector<int> &gpoints) {
+    fft_radix2(work, twiddles, false);
+    for (std::size_t i = 0; i < P; ++i) work[i] *= kernel[i];
+    fft_radix2(work, twiddles, true);
+
+    y.resize(M);
+    for (std::size_t i = 0; i < M; ++i) {
+      y[i] = work[i].real() / double(P);
+    }
+    remove_noise(y);
+    if (hits2 != NULL) {
+      y2.resize(M);
+      for (std::size_t i = 0; i < M; ++i) {
+        y2[i] = work[i].imag() / double(P);
+      }
+      remove_noise(y2);
+    }
+
+  }
+
+};
+
+/* 0-based positions i of local maxima: x[i] is higher than x[i - 1] or
+ * x[i + 1] with neither being higher (diff(sign(diff(x))) < 0), and no value
+ * within m positions on either side is higher.
+ *
+ * Single pass with a monotone deque holding the indices of decreasing values
+ * in the window [i - m, i + m], so the window maximum is always at the front
+ * and each index is pushed and popped at most once: O(n) regardless of m
+ * (checking every window in full is O(n m), e.g. 3.1 s instead of 0.08 s for
+ * 10^7 values with m = 500). The deque lives in `window`, used as a ring
+ * buffer. `peaks` and `window` are only reallocated if they are too small,
+ * so reusing them across calls makes this allocation free. */
+void find_peaks(const double *x, const std::size_t &n, const std::size_t &m,
+    vec_int_t &peaks, vec_int_t &window) {
 
-  double M = gpoints.size(), b = gpoints.size(), n = x.size(), a = 1;
+  peaks.clear();
+  if (n < 3) return;
 
-  std::vector<double> gcnts(M, 0.0);
-  double delta = (b - a) / (M - 1);
+  /* ring buffer: the deque never holds more than the 2m + 1 window indices */
+  std::size_t cap = 1;
+  while (cap < 2 * m + 2) cap <<= 1;
+  if (window.size() < cap) window.resize(cap);
+  int *dq = window.data();
+  const std::size_t mask = cap - 1;
+  std::size_t head = 0, tail = 0, next = 0;
 
-  double lxi, rem, li;
+  for (std::size_t i = 1; i < n - 1; ++i) {
 
-  for (int i = 0; i < n; ++i) {
-    lxi = ((x[i] - a) / delta) + 1;
-    li = trunc(lxi);
-    rem = lxi - li;
-    if (li > 1 && li < M) {
-      gcnts[li - 1] += (1 - rem);
-      gcnts[li] += rem;
+    const int left = (x[i] > x[i - 1]) - (x[i] < x[i - 1]);
+    const int right = (x[i + 1] > x[i]) - (x[i + 1] < x[i]);
+    if (right - left >= 0) continue;
+
+    /* the deque is only brought up to date at candidates, and restarted if
+     * the previous window does not reach this one */
+    const std::size_t from = i > m ? i - m : 0;
+    const std::size_t to = i + m < n - 1 ? i + m : n - 1;
+    if (next < from) {
+      head = tail = 0;
+      next = from;
+    }
+    while (tail > head && std::size_t(dq[head & mask]) < from) ++head;
+    for (; next <= to; ++next) {
+      while (tail > head && x[dq[(tail - 1) & mask]] <= x[next]) --tail;
+      dq[tail++ & mask] = next;
     }
+
+    if (!(x[dq[head & mask]] > x[i])) peaks.push_back(i);
+
+  }
+
+}
+
+struct moments_t {
+  double n = 0, mean = 0, m2 = 0;
+  void add(const double &x) {
+    n += 1;
+    const double d = x - mean;
+    mean += d / n;
+    m2 += d * (x - mean);
+  }
+  /* Chan et al. pairwise update */
+  void merge(const moments_t &o) {
+    if (o.n == 0) return;
+    const double tot = n + o.n, d = o.mean - mean;
+    mean += d * o.n / tot;
+    m2 += o.m2 + d * d * n * o.n / tot;
+    n = tot;
   }
+};
+
+/* C++ ENTRY ---------------------------------------------------------------- */
+
+// [[Rcpp::export(rng = false)]]
+Rcpp::IntegerVector peakfinder_cpp(const Rcpp::NumericVector &x, int m = 3) {
+
+  vec_int_t peaks, window;
+  find_peaks(x.begin(), x.size(), m, peaks, window);
+  for (std::size_t i = 0; i < peaks.size(); ++i) peaks[i] += 1;
+
+  return Rcpp::wrap(peaks);
+
+}
+
+// [[Rcpp::export(rng = false)]]
+Rcpp::List motif_peaks_cpp(const std::vector<int> &hits, const int seqlen,
+    const double bandwidth, const int peakwidth, const int nrand,
+    const int nthreads, const int seed) {
+
+  // Returns the density of the hits at positions 1..seqlen, the (1-based)
+  // peak positions and the mean, MLE standard deviation and number of the
+  // peak heights of the random hits.
+
+  unsigned int useed = seed;
+  const std::size_t nhits = hits.size(), len = seqlen, m = peakwidth;
+  const kde_t kde(len, bandwidth, nhits);
+
+  vec_cplx_t work(kde.P);
+  vec_num_t y, unused;
+  vec_int_t peaks, window;
+  kde.density(hits.data(), NULL, nhits, work, y, unused);
+  find_peaks(y.data(), len, m, peaks, window);
+  for (std::size_t i = 0; i < peaks.size(); ++i) peaks[i] += 1;
+
+  const std::size_t nblocks = (std::size_t(nrand) + PEAKS_BLOCK_SIZE - 1)
+    / PEAKS_BLOCK_SIZE;
+  std::vector<moments_t> block_moments(nblocks);
+
+  RcppThread::parallelFor(0, nblocks,
+      [&block_moments, &kde, &nhits, &len, &m, &nrand, &useed]
+      (std::size_t b) {
+
+        vec_cplx_t rwork(kde.P);
+        vec_num_t ry1, ry2;
+        vec_int_t rhits1(nhits), rhits2(nhits), rpeaks, rwindow;
+        const std::size_t from = b * PEAKS_BLOCK_SIZE;
+        const std::size_t to = std::min(from + PEAKS_BLOCK_SIZE, std::size_t(nrand));
+
+        /* replicates r and r + 1 share a pair of FFTs */
+        for (std::size_t r = from; r < to; r += 2) {
+          const bool pair = r + 1 < to;
+          rng_t gen1(useed, r);
+          for (std::size_t i = 0; i < nhits; ++i) {
+            rhits1[i] = 1 + gen1.below(len);
+          }
+          if (pair) {
+            rng_t gen2(useed, r + 1);
+            for (std::size_t i = 0; i < nhits; ++i) {
+              rhits2[i] = 1 + gen2.below(len);
+            }
+          }
+          kde.density(rhits1.data(), pair ? rhits2.data() : NULL, nhits,
+              rwork, ry1, ry2);
+          find_peaks(ry1.data(), len, m, rpeaks, rwindow);
+          for (std::size_t i = 0; i < rpeaks.size(); ++i) {
+            block_moments[b].add(ry1[rpeaks[i]]);
+          }
+          if (pair) {
+            find_peaks(ry2.data(), len, m, rpeaks, rwindow);
+            for (std::size_t i = 0; i < rpeaks.size(); ++i) {
+              block_moments[b].add(ry2[rpeaks[i]]);
+            }
+          }
+        }
+
+      }, nthreads);
+
+  moments_t null;
+  for (std::size_t b = 0; b < nblocks; ++b) null.merge(block_moments[b]);
 
-  return gcnts;
+  return Rcpp::List::create(
+    Rcpp::_["y"] = y,
+    Rcpp::_["peaks"] = peaks,
+    Rcpp::_["null.mean"] = null.mean,
+    Rcpp::_["null.sd"] = null.n > 0 ? std::sqrt(null.m2 / null.n) : NA_REAL,
+    Rcpp::_["null.n"] = null.n
+  );
 
 }
@@ -0,0 +1,70 @@
+#ifndef _RNG_
+#define _RNG_
+
+#include <cstdint>
+#include <limits>
+
+/* xoshiro256** (Blackman and Vigna 2018). The state is only 32 bytes, so unlike
+ * std::mt19937 (~5 KB) it is cheap to create one generator per sequence.
+ *
+ * Streams are counter-based: stream i is seeded with outputs 4i to 4i+3 of a
+ * splitmix64 sequence started from `seed`, so every stream gets distinct,
+ * well-mixed starting states and the results depend only on (seed, i) and
+ * never on the number of threads. Can be used with std::shuffle and the
+ * other <random> distributions. */
+struct rng_t {
+
+  typedef std::uint64_t result_type;
+
+  std::uint64_t s[4];
+
+  rng_t(const std::uint64_t seed, const std::uint64_t stream = 0) {
+    std::uint64_t x = seed + stream * 4 * 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < 4; ++i) {
+      x += 0x9E3779B97F4A7C15ULL;
+      std::uint64_t z = x;
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      s[i] = z ^ (z >> 31);
+    }
+  }
+
+  static constexpr result_type min() {
+    return std::numeric_limits<result_type>::min();
+  }
+
+  static constexpr result_type max() {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  result_type operator()() {
+    const std::uint64_t out = rotl(s[1] * 5, 7) * 9;
+    const std::uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return out;
+  }
+
+  /* uniform double in [0, 1) using the top 53 bits */
+  double uniform() {
+    return double((*this)() >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  /* uniform integer in [0, n); the bias is negligible for n << 2^64 */
+  std::uint64_t below(const std::uint64_t n) {
+    return std::uint64_t(uniform() * double(n));
+  }
+
+  private:
+
+  static std::uint64_t rotl(const std::uint64_t x, const int k) {
+    return (x << k) | (x >> (64 - k));
+  }
+
+};
+
+#endif
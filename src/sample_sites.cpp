@@ -0,0 +1,274 @@
+#include <Rcpp.h>
+#include <RcppThread.h>
+#include <cmath>
+#include "types.h"
+#include "rng.h"
+#include "shuffle_sequences.h"
+#include "utils-internal.h"
+
+/* Sites are drawn from a k-let probability matrix (k = 1 for the regular
+ * motif matrix). The first k letters come from the k-let probabilities of the
+ * first column; each following letter is drawn from column i given the
+ * previous k-1 letters, i.e. from the alphlen rows of column i sharing that
+ * (k-1)-let prefix:
+ *
+ *        A C A | | | | | | |
+ *  i=1 . - C A A | | | | | |
+ *  i=2 . --- A A T | | | | |
+ *  i=3 . ----- A T G | | | |
+ *        ===================
+ *        A C A A T G C C C G
+ *
+ * Every column/prefix gets its own alias table (site_sampler_t), so each
+ * letter costs one uniform draw. Site i uses random stream i, so results do
+ * not depend on the number of threads.
+ *
+ * Timings for 10^6 sites from a 10 column DNA motif: 316 ms (single thread).
+ */
+
+struct site_sampler_t {
+
+  std::size_t alphlen, ncol, nlets, mlets, sitelen;
+  vec_num_t first_prob, next_prob;
+  vec_int_t first_alias, next_alias;
+
+  site_sampler_t(const list_num_t &kmat, const std::size_t &alphlen_,
+      const int &k) : alphlen(alphlen_), ncol(kmat.size()),
+      nlets(kmat[0].size()), mlets(nlets / alphlen), sitelen(ncol + k - 1),
+      first_prob(nlets), first_alias(nlets) {
+
+    alias_setup(kmat[0], first_prob, first_alias, 0);
+
+    /* column i > 0, prefix p: offset ((i - 1) * mlets + p) * alphlen */
+    next_prob.assign(ncol > 1 ? (ncol - 1) * nlets : 0, 0.0);
+    next_alias.assign(next_prob.size(), 0);
+    vec_num_t weights(alphlen);
+    for (std::size_t i = 1; i < ncol; ++i) {
+      for (std::size_t p = 0; p < mlets; ++p) {
+        for (std::size_t j = 0; j < alphlen; ++j) {
+          weights[j] = kmat[i][p * alphlen + j];
+        }
+        alias_setup(weights, next_prob, next_alias,
+            ((i - 1) * mlets + p) * alphlen);
+      }
+    }
+
+  }
+
+  /* letter indices of one site */
+  void draw(vec_int_t &site, rng_t &gen) const {
+    site.clear();
+    std::size_t klet = alias_draw(first_prob, first_alias, 0, nlets, gen);
+    for (std::size_t div = nlets / alphlen; div > 0; div /= alphlen) {
+      site.push_back((klet / div) % alphlen);
+    }
+    for (std::size_t i = 1; i < ncol; ++i) {
+      const std::size_t prefix = klet % mlets;
+      const std::size_t let = alias_draw(next_prob, next_alias,
+          ((i - 1) * mlets + prefix) * alphlen, alphlen, gen);
+      site.push_back(let);
+      klet = prefix * alphlen + let;
+    }
+  }
+
+};
+
+vec_str_t sample_sites_k(const list_num_t &kmat, const int &k,
+    const vec_str_t &alph, const std::size_t &n, const int &nthreads,
+    const std::uint64_t &seed) {
+
+  const site_sampler_t sampler(kmat, alph.size(), k);
+
+  vec_str_t sites(n);
+
+  RcppThread::parallelFor(0, n,
+      [&sites, &alph, &sampler, seed] (std::size_t s) {
+        rng_t gen(seed, s);
+        vec_int_t site_ints;
+        sampler.draw(site_ints, gen);
+        std::string &site = sites[s];
+        site.reserve(site_ints.size());
+        for (std::size_t i = 0; i < site_ints.size(); ++i) {
+          site += alph[site_ints[i]];
+        }
+      }, nthreads);
+
+  return sites;
+
+}
+
+/* Implanting sites into Markov background sequences.
+ *
+ * The background of sequence i is made exactly as in create_sequences_cpp()
+ * (random stream i), so it is the same as create_sequences() output for the
+ * same seed. Sites are then drawn using stream seqnum + i: for every motif, in
+ * order, the sequence gets floor(rate) sites plus one more with probability
+ * rate - floor(rate). Each site is drawn from the motif, reverse complemented
+ * half of the time if rc (only for DNA/RNA, where the complement of letter j
+ * is letter alphlen - 1 - j), and placed either uniformly or with its centre
+ * normally distributed around the centre of the sequence (pos_sd > 0, draws
+ * falling off the sequence are retried). Sites never overlap; one which does
+ * not fit after IMPLANT_MAX_TRIES positions is dropped.
+ */
+
+const std::size_t IMPLANT_MAX_TRIES = 100;
+
+struct implant_t {
+  std::size_t motif;
+  std::size_t start;
+  bool rc;
+  std::string site;
+};
+
+void implant_sites_one(std::string &seq, std::vector<implant_t> &implants,
+    const std::vector<site_sampler_t> &samplers, const vec_str_t &alph,
+    const vec_num_t &rates, const bool &rc, const double &pos_sd,
+    rng_t &gen) {
+
+  const std::size_t seqlen = seq.size(), alphlen = alph.size();
+  vec_int_t site_ints;
+
+  for (std::size_t m = 0; m < samplers.size(); ++m) {
+
+    const std::size_t w = samplers[m].sitelen;
+    if (w > seqlen) continue;
+
+    std::size_t nsites = std::size_t(rates[m]);
+    if (gen.uniform() < rates[m] - double(nsites)) ++nsites;
+
+    for (std::size_t s = 0; s < nsites; ++s) {
+
+      const bool rev = rc && gen.uniform() < 0.5;
+      samplers[m].draw(site_ints, gen);
+
+      std::size_t start = 0;
+      bool placed = false;
+      for (std::size_t t = 0; t < IMPLANT_MAX_TRIES && !placed; ++t) {
+        if (pos_sd > 0) {
+          /* Box-Muller, so the positions do not depend on the standard
+           * library */
+          const double z = std::sqrt(-2.0 * std::log(1.0 - gen.uniform()))
+            * std::cos(2.0 * M_PI * gen.uniform());
+          const double from = std::round(double(seqlen) / 2.0 + pos_sd * z
+              - double(w) / 2.0);
+          if (from < 0 || from + double(w) > double(seqlen)) continue;
+          start = std::size_t(from);
+        } else {
+          start = gen.below(seqlen - w + 1);
+        }
+        placed = true;
+        for (std::size_t j = 0; j < implants.size(); ++j) {
+          const std::size_t ostart = implants[j].start;
+          const std::size_t ostop = ostart + implants[j].site.size();
+          if (start < ostop && ostart < start + w) {
+            placed = false;
+            break;
+          }
+        }
+      }
+      if (!placed) continue;
+
+      implant_t implant;
+      implant.motif = m;
+      implant.start = start;
+      implant.rc = rev;
+      for (std::size_t j = 0; j < w; ++j) {
+        implant.site += alph[site_ints[j]];
+        seq[start + j] = rev ? alph[alphlen - 1 - site_ints[w - 1 - j]][0]
+                             : alph[site_ints[j]][0];
+      }
+      implants.push_back(implant);
+
+    }
+
+  }
+
+}
+
+// [[Rcpp::export(rng = false)]]
+std::vector<std::string> sample_sites_cpp(const Rcpp::NumericMatrix &kmat,
+    const int k, const std::vector<std::string> &alph, const int n,
+    const int nthreads, const int seed) {
+
+  unsigned int useed = seed;
+  return sample_sites_k(R_to_cpp_motif_num(kmat), k, alph, std::size_t(n),
+      nthreads, useed);
+
+}
+
+// [[Rcpp::export(rng = false)]]
+Rcpp::List implant_sites_cpp(const int seqlen, const int seqnum,
+    const std::vector<std::string> &alph, const int k,
+    const std::vector<double> &freqs, const Rcpp::NumericMatrix &transitions,
+    const Rcpp::List &motifs, const std::vector<double> &rates, const bool rc,
+    const double position_sd, const int nthreads, const int seed) {
+
+  unsigned int useed = seed;
+  const std::size_t nseqs = seqnum;
+
+  vec_num_t first_prob, trans_prob;
+  vec_int_t first_alias, trans_alias;
+  create_seq_tables(alph.size(), k, freqs, R_to_cpp_motif_num(transitions),
+      first_prob, first_alias, trans_prob, trans_alias);
+
+  std::vector<site_sampler_t> samplers;
+  samplers.reserve(motifs.size());
+  for (R_xlen_t i = 0; i < motifs.size(); ++i) {
+    Rcpp::NumericMatrix mot = motifs[i];
+    samplers.push_back(site_sampler_t(R_to_cpp_motif_num(mot), alph.size(), 1));
+  }
+
+  vec_str_t seqs(nseqs);
+  std::vector<std::vector<implant_t>> implants(nseqs);
+
+  RcppThread::parallelFor(0, nseqs,
+      [&seqs, &implants, &seqlen, &alph, &useed, &nseqs, &first_prob,
+       &first_alias, &trans_prob, &trans_alias, &k, &samplers, &rates, &rc,
+       &position_sd]
+      (std::size_t i) {
+
+        rng_t gen(useed, i);
+        std::size_t mlet = 0;
+        seqs[i].reserve(seqlen);
+        create_seq_segment(seqs[i], 0, seqlen, alph, k, first_prob,
+            first_alias, trans_prob, trans_alias, gen, mlet);
+
+        rng_t igen(useed, nseqs + i);
+        implant_sites_one(seqs[i], implants[i], samplers, alph, rates, rc,
+            position_sd, igen);
+
+      }, nthreads);
+
+  std::size_t n = 0;
+  for (std::size_t i = 0; i < nseqs; ++i) n += implants[i].size();
+
+  /* scan_sequences() style coordinates: start > stop on the minus strand */
+  Rcpp::IntegerVector sequence(n), motif(n), start(n), stop(n);
+  Rcpp::CharacterVector strand(n), match(n);
+  std::size_t row = 0;
+  for (std::size_t i = 0; i < nseqs; ++i) {
+    for (std::size_t j = 0; j < implants[i].size(); ++j, ++row) {
+      const implant_t &imp = implants[i][j];
+      sequence[row] = i + 1;
+      motif[row] = imp.motif + 1;
+      start[row] = imp.rc ? imp.start + imp.site.size() : imp.start + 1;
+      stop[row] = imp.rc ? imp.start + 1 : imp.start + imp.site.size();
+      strand[row] = imp.rc ? "-" : "+";
+      match[row] = imp.site;
+    }
+  }
+
+  return Rcpp::List::create(
+    Rcpp::_["sequences"] = seqs,
+    Rcpp::_["sites"] = Rcpp::DataFrame::create(
+      Rcpp::_["sequence"] = sequence,
+      Rcpp::_["motif"] = motif,
+      Rcpp::_["start"] = start,
+      Rcpp::_["stop"] = stop,
+      Rcpp::_["strand"] = strand,
+      Rcpp::_["match"] = match,
+      Rcpp::_["stringsAsFactors"] = false
+    )
+  );
+
+}
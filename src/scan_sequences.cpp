@@ -2,7 +2,16 @@
 #include <RcppThread.h>
 #include <algorithm>
 #include <cmath>
+#include <numeric>
+#include <limits>
 #include "types.h"
+#include "utils-internal.h"
+#include "rng.h"
+#include "shuffle_sequences.h"
+#include "enrich_motifs.h"
+#include "scan_sequences.h"
+
+const std::size_t SHUFFLE_SCAN_BATCH_SIZE = 64;
 
 void deal_with_higher_k_NA(list_int_t &seq_ints, const int &k, const int &let_len) {
 
@@ -149,7 +158,7 @@ list_mat_t scan_sequences_cpp_internal(const list_mat_t &score_mats,
 }
 
 list_int_t format_results(const list_mat_t &out_pre, const vec_int_t &scores,
-    const list_mat_t &motifs) {
+    const list_mat_t &motifs, const int &k) {
 
   list_int_t res(5);
 
@@ -162,7 +171,7 @@ list_int_t format_results(const list_mat_t &out_pre, const vec_int_t &scores,
           res[0].push_back(i + 1);                 // motif
           res[1].push_back(j + 1);                 // sequence
           res[2].push_back(b + 1);                 // start
-          res[3].push_back(b + motifs[i].size());  // stop
+          res[3].push_back(b + motifs[i].size() + k - 1);  // stop
           res[4].push_back(out_pre[i][j][b]);      // score
         }
       }
@@ -174,13 +183,14 @@ list_int_t format_results(const list_mat_t &out_pre, const vec_int_t &scores,
 }
 
 vec_str_t get_matches(const list_int_t &res, const vec_str_t &seq_vecs,
-    const list_mat_t &motifs) {
+    const list_mat_t &motifs, const int &k) {
 
   vec_str_t out;
   out.reserve(res[0].size());
 
   for (std::size_t i = 0; i < res[0].size(); ++i) {
-    out.push_back(seq_vecs[res[1][i] - 1].substr(res[2][i] - 1, motifs[res[0][i] - 1].size()));
+    out.push_back(seq_vecs[res[1][i] - 1].substr(res[2][i] - 1,
+          motifs[res[0][i] - 1].size() + k - 1));
   }
 
   return out;
@@ -193,6 +203,251 @@ void replace_gap_chars(str_t &seqstring, const vec_int_t &gaplocs) {
   }
 }
 
+list_mat_t score_mats_to_ints(const Rcpp::List &score_mats) {
+
+  list_mat_t score2_mats(score_mats.size());
+  for (R_xlen_t i = 0; i < score_mats.size(); ++i) {
+    Rcpp::NumericMatrix tmp = score_mats[i];
+    score2_mats[i].reserve(tmp.ncol());
+    for (R_xlen_t j = 0; j < tmp.ncol(); ++j) {
+      Rcpp::NumericVector tmp2 = tmp(Rcpp::_, j);
+      tmp2 = tmp2 * 1000;
+      score2_mats[i].push_back(vec_int_t(tmp2.begin(), tmp2.end()));
+    }
+  }
+
+  return score2_mats;
+
+}
+
+void klet_indices_NA(const vec_int_t &seq_ints, vec_int_t &klets,
+    const int &k, const int &alphlen) {
+
+  // Letters equal to alphlen are non-standard; any k-let containing one
+  // becomes -1, same as deal_with_higher_k_NA().
+
+  klets.assign(seq_ints.size() - k + 1, 0);
+
+  int l, nbad = 0;
+  for (int i = 0; i < k - 1; ++i) {
+    if (seq_ints[i] == alphlen) ++nbad;
+  }
+  for (std::size_t i = 0; i < klets.size(); ++i) {
+    if (seq_ints[i + k - 1] == alphlen) ++nbad;
+    if (nbad > 0) {
+      klets[i] = -1;
+    } else {
+      l = 0;
+      for (int b = 0; b < k; ++b) {
+        l = l * alphlen + seq_ints[i + b];
+      }
+      klets[i] = l;
+    }
+    if (seq_ints[i] == alphlen) --nbad;
+  }
+
+}
+
+void scan_hit_starts(const vec_int_t &motif_col_flat, const std::size_t &mlen,
+    const std::size_t &nrow, const vec_int_t &klets, const int &min_score,
+    vec_int_t &starts) {
+
+  starts.clear();
+  if (klets.size() < mlen) return;
+
+  int tmp;
+  for (std::size_t i = 0; i < klets.size() - mlen + 1; ++i) {
+    tmp = 0;
+    for (std::size_t j = 0; j < mlen; ++j) {
+      if (klets[i + j] < 0)
+        tmp += -999999;
+      else
+        tmp += motif_col_flat[j * nrow + klets[i + j]];
+    }
+    if (tmp >= min_score) starts.push_back(i);
+  }
+
+}
+
+bool scan_best_hit(const vec_int_t &motif_col_flat, const std::size_t &mlen,
+    const std::size_t &nrow, const vec_int_t &klets, int &best_score,
+    std::size_t &best_start) {
+
+  if (klets.size() < mlen) return false;
+
+  best_score = std::numeric_limits<int>::min();
+  best_start = 0;
+  int tmp;
+  for (std::size_t i = 0; i < klets.size() - mlen + 1; ++i) {
+    tmp = 0;
+    for (std::size_t j = 0; j < mlen; ++j) {
+      if (klets[i + j] < 0)
+        tmp += -999999;
+      else
+        tmp += motif_col_flat[j * nrow + klets[i + j]];
+    }
+    if (tmp > best_score) {
+      best_score = tmp;
+      best_start = i;
+    }
+  }
+
+  return true;
+
+}
+
+std::size_t count_kept_hits(const vec_int_t &starts, const vec_int_t &run_ends,
+    const int &width, vec_bool_t &removed) {
+
+  // The number of hits kept by scan_sequences(no.overlaps = TRUE) out of the
+  // hits of one motif in one sequence, in the order of its results: runs of
+  // ascending starts, one per score matrix (forward, then reverse
+  // complement). Overlapping hits are removed there by cutting the complete
+  // linkage hclust() tree of the overlaps at 0.5, keeping one hit per
+  // cluster (whichever no.overlaps.strat is used). With 0/1 distances this
+  // only merges clusters whose hits all overlap, always into the first hit
+  // (in result order) which still overlaps a later one. So each remaining
+  // hit in turn takes in every later hit for which the cluster still spans
+  // less than one motif width.
+
+  const std::size_t n = starts.size();
+  removed.assign(n, false);
+
+  std::size_t kept = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    if (removed[i]) continue;
+    ++kept;
+    int lo = starts[i], hi = starts[i];
+    std::size_t run_start = 0;
+    for (std::size_t r = 0; r < run_ends.size(); ++r) {
+      const std::size_t run_end = run_ends[r];
+      if (run_end > i + 1) {
+        auto j = std::lower_bound(starts.begin() + std::max(run_start, i + 1),
+            starts.begin() + run_end, hi - width + 1) - starts.begin();
+        for (; std::size_t(j) < run_end && starts[j] < lo + width; ++j) {
+          if (removed[j]) continue;
+          const int s = starts[j];
+          if (std::max(hi, s) - std::min(lo, s) < width) {
+            removed[j] = true;
+            lo = std::min(lo, s);
+            hi = std::max(hi, s);
+          }
+        }
+      }
+      run_start = run_end;
+    }
+  }
+
+  return kept;
+
+}
+
+/* Score matrices for counting hits, for k-lets of size k: len is the number
+ * of columns (k-lets) of each matrix, width the number of letters it spans
+ * (len + k - 1), mot the 0-based motif each matrix belongs to (reverse
+ * complement matrices share the index of their forward motif) and mot_width
+ * the width of each motif. */
+struct count_mats_t {
+
+  list_int_t flat;
+  vec_int_t len, width, score, mot, mot_width;
+  std::size_t nmats, nmots, nrow;
+
+  count_mats_t(const Rcpp::List &score_mats, const vec_num_t &min_scores,
+      const vec_int_t &mot_index, const int &nmots_, const int &k)
+      : nmats(score_mats.size()), nmots(nmots_) {
+
+    list_mat_t mats = score_mats_to_ints(score_mats);
+    flat.resize(nmats);
+    len.resize(nmats);
+    width.resize(nmats);
+    score.resize(nmats);
+    mot.resize(nmats);
+    mot_width.assign(nmots, 0);
+    for (std::size_t i = 0; i < nmats; ++i) {
+      len[i] = mats[i].size();
+      width[i] = len[i] + k - 1;
+      mot[i] = mot_index[i] - 1;
+      mot_width[mot[i]] = width[i];
+      score[i] = min_scores[i] * 1000;
+      for (std::size_t j = 0; j < mats[i].size(); ++j) {
+        flat[i].insert(flat[i].end(), mats[i][j].begin(), mats[i][j].end());
+      }
+    }
+    nrow = mats[0][0].size();
+
+  }
+
+};
+
+struct count_scratch_t {
+  vec_int_t starts, run_end;
+  list_int_t mot_starts, mot_runs;
+  vec_bool_t mot_hit, removed;
+};
+
+void count_klet_hits(const vec_int_t &klets, const count_mats_t &mats,
+    const bool &no_overlaps, const bool &by_strand, count_scratch_t &scratch,
+    vec_num_t &hits, vec_num_t &seq_hits) {
+
+  // Adds the hits of every motif in one sequence (as k-let indices) to hits,
+  // and one to seq_hits for every motif with at least one hit. With
+  // no_overlaps, only the hits which scan_sequences() would keep are counted
+  // (see count_kept_hits()), per strand if by_strand.
+
+  scratch.mot_hit.assign(mats.nmots, false);
+  scratch.mot_starts.resize(mats.nmots);
+  scratch.mot_runs.resize(mats.nmots);
+
+  for (std::size_t m = 0; m < mats.nmats; ++m) {
+    scan_hit_starts(mats.flat[m], mats.len[m], mats.nrow, klets, mats.score[m],
+        scratch.starts);
+    if (scratch.starts.empty()) continue;
+    const int mot = mats.mot[m];
+    scratch.mot_hit[mot] = true;
+    if (!no_overlaps) {
+      hits[mot] += scratch.starts.size();
+    } else if (by_strand) {
+      scratch.run_end.assign(1, scratch.starts.size());
+      hits[mot] += count_kept_hits(scratch.starts, scratch.run_end,
+          mats.width[m], scratch.removed);
+    } else {
+      scratch.mot_starts[mot].insert(scratch.mot_starts[mot].end(),
+          scratch.starts.begin(), scratch.starts.end());
+      scratch.mot_runs[mot].push_back(scratch.mot_starts[mot].size());
+    }
+  }
+
+  for (std::size_t m = 0; m < mats.nmots; ++m) {
+    if (!scratch.mot_hit[m]) continue;
+    ++seq_hits[m];
+    if (no_overlaps && !by_strand) {
+      hits[m] += count_kept_hits(scratch.mot_starts[m], scratch.mot_runs[m],
+          mats.mot_width[m], scratch.removed);
+      scratch.mot_starts[m].clear();
+      scratch.mot_runs[m].clear();
+    }
+  }
+
+}
+
+/* A hit starting at i of the n possible starts is central if
+ * |2i - (n - 1)| <= central_limit(), i.e. its centre is within width / 2 of
+ * the sequence centre relative to the range of possible hit centres. */
+long central_limit(const std::size_t &n, const double &width) {
+  return std::min(n - 1, std::size_t(width * (n - 1)));
+}
+
+/* number of central starts out of n */
+std::size_t central_starts(const std::size_t &n, const double &width) {
+
+  if (n <= 1) return n;
+  const std::size_t t = central_limit(n, width);
+  if ((n - 1) % 2 == 0) return 2 * (t / 2) + 1;
+  return 2 * ((t + 1) / 2);
+
+}
+
 /* C++ ENTRY ---------------------------------------------------------------- */
 
 // [[Rcpp::export(rng = false)]]
@@ -289,16 +544,9 @@ Rcpp::DataFrame scan_sequences_cpp(const Rcpp::List &score_mats,
   std::vector<int> motif_sizes(score_mats.size());
   std::vector<int> seq_sizes(seq_vecs.size());
 
-  list_mat_t score2_mats(score_mats.size());
-  for (R_xlen_t i = 0; i < score_mats.size(); ++i) {
-    Rcpp::NumericMatrix tmp = score_mats[i];
-    score2_mats[i].reserve(tmp.ncol());
-    motif_sizes[i] = tmp.ncol();
-    for (R_xlen_t j = 0; j < tmp.ncol(); ++j) {
-      Rcpp::NumericVector tmp2 = tmp(Rcpp::_, j);
-      tmp2 = tmp2 * 1000;
-      score2_mats[i].push_back(vec_int_t(tmp2.begin(), tmp2.end()));
-    }
+  list_mat_t score2_mats = score_mats_to_ints(score_mats);
+  for (std::size_t i = 0; i < score2_mats.size(); ++i) {
+    motif_sizes[i] = score2_mats[i].size();
   }
 
   for (std::size_t i = 0; i < seq_vecs.size(); ++i) {
@@ -315,14 +563,14 @@ Rcpp::DataFrame scan_sequences_cpp(const Rcpp::List &score_mats,
   list_mat_t out_pre = scan_sequences_cpp_internal(score2_mats, seq2_vecs, k,
       alph2, nthreads, warnNA);
 
-  list_int_t res = format_results(out_pre, min_scores2, score2_mats);
+  list_int_t res = format_results(out_pre, min_scores2, score2_mats, k);
 
   vec_num_t scores2 = vec_num_t(res[4].begin(), res[4].end());
   for (std::size_t i = 0; i < scores2.size(); ++i) {
     scores2[i] /= 1000;
   }
 
-  vec_str_t matches = get_matches(res, seq_vecs, score2_mats);
+  vec_str_t matches = get_matches(res, seq_vecs, score2_mats, k);
 
   return Rcpp::DataFrame::create(
         Rcpp::_["motif"] = res[0],
@@ -337,3 +585,328 @@ Rcpp::DataFrame scan_sequences_cpp(const Rcpp::List &score_mats,
       );
 
 }
+
+// [[Rcpp::export(rng = false)]]
+Rcpp::List shuffle_scan_cpp(const Rcpp::List &score_mats,
+    const std::vector<std::string> &sequences, const int &k,
+    const std::string &alph, const std::vector<double> &min_scores,
+    const std::vector<int> &mot_index, const int &nmots, const int &shuffle_k,
+    const int &method, const int &reps, const int &nthreads, const int &seed,
+    const bool &no_overlaps = false, const bool &by_strand = false) {
+
+  // Shuffle each sequence `reps` times and scan every replicate right away,
+  // keeping only per-motif hit counts; the shuffled sequences are never
+  // stored. Score matrices map to motifs via the 1-based mot_index (reverse
+  // complement matrices share the index of their forward motif). Each
+  // sequence is shuffled in its own alphabet (see encode_seq()) and
+  // replicate r of sequence i uses random number stream r * nseqs + i, as in
+  // shuffle_sequences(), so the replicates are exactly those it would make
+  // with the same seed. They are then recoded to the motif alphabet.
+
+  unsigned int useed = seed;
+  std::size_t nseqs = sequences.size();
+  int alphlen = alph.size();
+
+  const count_mats_t mats(score_mats, min_scores, mot_index, nmots, k);
+
+  /* letters outside the motif alphabet become an extra letter, alphlen */
+  vec_int_t lookup(256, alphlen);
+  for (int i = 0; i < alphlen; ++i) {
+    lookup[(unsigned char)alph[i]] = i;
+  }
+
+  /* the work is split into units of one sequence and a block of rb of its
+   * replicates, with blocks small enough for every thread to get some work
+   * even for a few sequences; consecutive units of a batch which share a
+   * sequence also share its k-let graph */
+  std::size_t ureps = reps;
+  std::size_t rb = parallel_batch_size(nseqs * ureps, nthreads, ureps);
+  std::size_t nblocks = (ureps + rb - 1) / rb, nunits = nseqs * nblocks;
+  std::size_t batch_size = parallel_batch_size(nunits, nthreads,
+      SHUFFLE_SCAN_BATCH_SIZE);
+  std::size_t nbatches = (nunits + batch_size - 1) / batch_size;
+  list_num_t batch_hits(nbatches), batch_seq_hits(nbatches);
+
+  RcppThread::parallelFor(0, nbatches,
+      [&batch_hits, &batch_seq_hits, &sequences, &lookup, &mats, &nmots,
+       &nseqs, &alphlen, &k, &shuffle_k, &method, &ureps, &useed, &no_overlaps,
+       &by_strand, &rb, &nblocks, &nunits, &batch_size] (std::size_t b) {
+
+        shuffle_scratch_t scratch;
+        count_scratch_t cscratch;
+        vec_int_t rep_ints, mot_ints, klets;
+        vec_num_t &hits = batch_hits[b];
+        vec_num_t &seq_hits = batch_seq_hits[b];
+        hits.assign(nmots, 0);
+        seq_hits.assign(nmots, 0);
+
+        std::string seq_alph;
+        std::size_t cur = nseqs;
+        bool ok = false;
+
+        std::size_t last = std::min((b + 1) * batch_size, nunits);
+
+        for (std::size_t u = b * batch_size; u < last; ++u) {
+
+          std::size_t i = u / nblocks, r0 = (u % nblocks) * rb;
+          std::size_t len = sequences[i].size();
+          if (len < std::size_t(k)) continue;
+          if (i != cur) {
+            seq_alph = encode_seq(sequences[i], scratch.seq_ints,
+                scratch.lookup);
+            ok = method == METHOD_EULER && euler_graph_ints(scratch.seq_ints,
+                0, len, seq_alph.size(), shuffle_k, scratch);
+            cur = i;
+          }
+          const std::size_t seq_alphlen = seq_alph.size();
+
+          for (std::size_t r = r0; r < std::min(r0 + rb, ureps); ++r) {
+
+            rng_t gen(useed, r * nseqs + i);
+            rep_ints.assign(scratch.seq_ints.begin(), scratch.seq_ints.end());
+            if (ok) {
+              euler_walk_ints(rep_ints, 0, len, seq_alphlen, shuffle_k, gen,
+                  scratch);
+            } else if (method != METHOD_EULER) {
+              shuffle_local_ints(rep_ints, 0, len, seq_alphlen, shuffle_k,
+                  method, gen, scratch);
+            }
+            mot_ints.resize(len);
+            for (std::size_t j = 0; j < len; ++j) {
+              mot_ints[j] = lookup[(unsigned char)seq_alph[rep_ints[j]]];
+            }
+            klet_indices_NA(mot_ints, klets, k, alphlen);
+
+            count_klet_hits(klets, mats, no_overlaps, by_strand, cscratch,
+                hits, seq_hits);
+
+          }
+
+        }
+
+      }, nthreads);
+
+  vec_num_t hits(nmots, 0), seq_hits(nmots, 0);
+  for (std::size_t b = 0; b < nbatches; ++b) {
+    for (int m = 0; m < nmots; ++m) {
+      hits[m] += batch_hits[b][m];
+      seq_hits[m] += batch_seq_hits[b][m];
+    }
+  }
+
+  return Rcpp::List::create(
+        Rcpp::_["hits"] = hits,
+        Rcpp::_["seq.hits"] = seq_hits
+      );
+
+}
+
+// [[Rcpp::export(rng = false)]]
+Rcpp::List count_hits_cpp(const Rcpp::List &score_mats,
+    const std::vector<std::string> &sequences, const int &k,
+    const std::string &alph, const std::vector<double> &min_scores,
+    const std::vector<int> &mot_index, const int &nmots, const int &nthreads,
+    const bool &no_overlaps = false, const bool &by_strand = false) {
+
+  // Per-motif hit and sequence hit counts, as shuffle_scan_cpp() but for the
+  // sequences themselves. Used by enrich_motifs() when the hits are not
+  // needed, so no hit table is ever made. With no_overlaps, the counts are
+  // those of scan_sequences(no.overlaps = TRUE). has.NA is TRUE if any
+  // letters outside the alphabet were found (these never match).
+
+  std::size_t nseqs = sequences.size();
+  int alphlen = alph.size();
+
+  const count_mats_t mats(score_mats, min_scores, mot_index, nmots, k);
+
+  vec_int_t lookup(256, alphlen);
+  for (int i = 0; i < alphlen; ++i) {
+    lookup[(unsigned char)alph[i]] = i;
+  }
+
+  std::size_t batch_size = parallel_batch_size(nseqs, nthreads,
+      SHUFFLE_SCAN_BATCH_SIZE);
+  std::size_t nbatches = (nseqs + batch_size - 1) / batch_size;
+  list_num_t batch_hits(nbatches), batch_seq_hits(nbatches);
+  vec_int_t batch_na(nbatches, 0);
+
+  RcppThread::parallelFor(0, nbatches,
+      [&batch_hits, &batch_seq_hits, &batch_na, &sequences, &lookup, &mats,
+       &nmots, &nseqs, &alphlen, &k, &no_overlaps, &by_strand, &batch_size]
+      (std::size_t b) {
+
+        count_scratch_t cscratch;
+        vec_int_t seq_ints, klets;
+        vec_num_t &hits = batch_hits[b];
+        vec_num_t &seq_hits = batch_seq_hits[b];
+        hits.assign(nmots, 0);
+        seq_hits.assign(nmots, 0);
+
+        std::size_t last = std::min((b + 1) * batch_size, nseqs);
+
+        for (std::size_t i = b * batch_size; i < last; ++i) {
+
+          std::size_t len = sequences[i].size();
+          if (len < std::size_t(k)) continue;
+          seq_ints.resize(len);
+          for (std::size_t j = 0; j < len; ++j) {
+            seq_ints[j] = lookup[(unsigned char)sequences[i][j]];
+            if (seq_ints[j] == alphlen) batch_na[b] = 1;
+          }
+          klet_indices_NA(seq_ints, klets, k, alphlen);
+
+          count_klet_hits(klets, mats, no_overlaps, by_strand, cscratch, hits,
+              seq_hits);
+
+        }
+
+      }, nthreads);
+
+  vec_num_t hits(nmots, 0), seq_hits(nmots, 0);
+  bool has_na = false;
+  for (std::size_t b = 0; b < nbatches; ++b) {
+    for (int m = 0; m < nmots; ++m) {
+      hits[m] += batch_hits[b][m];
+      seq_hits[m] += batch_seq_hits[b][m];
+    }
+    if (batch_na[b]) has_na = true;
+  }
+
+  return Rcpp::List::create(
+        Rcpp::_["hits"] = hits,
+        Rcpp::_["seq.hits"] = seq_hits,
+        Rcpp::_["has.NA"] = has_na
+      );
+
+}
+
+// [[Rcpp::export(rng = false)]]
+Rcpp::List scan_centrality_cpp(const Rcpp::List &score_mats,
+    const std::vector<std::string> &sequences, const int &k,
+    const std::string &alph, const std::vector<double> &min_scores,
+    const std::vector<int> &mot_index, const int &nmots, const int &nbins,
+    const double &central_width, const int &nthreads) {
+
+  // Positions of motif hits relative to the sequence centres, without
+  // keeping the hits. The relative position of a hit starting at i of the
+  // n = L - W + 1 possible starts is (2i - (n - 1)) / (n - 1), from -1 (at
+  // the sequence start) to 1 (at the end). Each batch of sequences fills its
+  // own histogram and counts, which are summed at the end.
+  //
+  // For the centrality test, a hit is central if its relative position is
+  // within central_width of zero (see central_limit()). Were hits placed
+  // uniformly, a hit in a sequence would be central with probability
+  // central_starts() / n; the sum of these over all hits is the expected
+  // number of central hits.
+
+  std::size_t nseqs = sequences.size();
+  int alphlen = alph.size();
+
+  const count_mats_t mats(score_mats, min_scores, mot_index, nmots, k);
+
+  vec_int_t lookup(256, alphlen);
+  for (int i = 0; i < alphlen; ++i) {
+    lookup[(unsigned char)alph[i]] = i;
+  }
+
+  std::size_t nbatches = (nseqs + SHUFFLE_SCAN_BATCH_SIZE - 1)
+    / SHUFFLE_SCAN_BATCH_SIZE;
+  list_num_t batch_hist(nbatches), batch_hits(nbatches),
+             batch_central(nbatches), batch_expected(nbatches),
+             batch_dist(nbatches);
+  vec_int_t batch_na(nbatches, 0);
+
+  RcppThread::parallelFor(0, nbatches,
+      [&batch_hist, &batch_hits, &batch_central, &batch_expected, &batch_dist,
+       &batch_na, &sequences, &lookup, &mats, &nmots, &nbins, &central_width,
+       &nseqs, &alphlen, &k] (std::size_t b) {
+
+        vec_int_t seq_ints, klets, starts;
+        vec_num_t &hist = batch_hist[b];
+        vec_num_t &hits = batch_hits[b];
+        vec_num_t &central = batch_central[b];
+        vec_num_t &expected = batch_expected[b];
+        vec_num_t &dist = batch_dist[b];
+        hist.assign(nmots * nbins, 0);
+        hits.assign(nmots, 0);
+        central.assign(nmots, 0);
+        expected.assign(nmots, 0);
+        dist.assign(nmots, 0);
+
+        std::size_t last = std::min((b + 1) * SHUFFLE_SCAN_BATCH_SIZE, nseqs);
+
+        for (std::size_t i = b * SHUFFLE_SCAN_BATCH_SIZE; i < last; ++i) {
+
+          std::size_t len = sequences[i].size();
+          if (len < std::size_t(k)) continue;
+          seq_ints.resize(len);
+          for (std::size_t j = 0; j < len; ++j) {
+            seq_ints[j] = lookup[(unsigned char)sequences[i][j]];
+            if (seq_ints[j] == alphlen) batch_na[b] = 1;
+          }
+          klet_indices_NA(seq_ints, klets, k, alphlen);
+
+          for (std::size_t m = 0; m < mats.nmats; ++m) {
+            scan_hit_starts(mats.flat[m], mats.len[m], mats.nrow, klets,
+                mats.score[m], starts);
+            if (starts.empty()) continue;
+            const int mot = mats.mot[m];
+            const std::size_t n = klets.size() - mats.len[m] + 1;
+            const double half = n > 1 ? 0.5 * (n - 1) : 1;
+            const long limit = central_limit(n, central_width);
+            const double p = double(central_starts(n, central_width)) / n;
+            for (std::size_t h = 0; h < starts.size(); ++h) {
+              const double r = (starts[h] - 0.5 * (n - 1)) / half;
+              int bin = (r + 1) * 0.5 * nbins;
+              if (bin >= nbins) bin = nbins - 1;
+              ++hist[mot * nbins + bin];
+              if (std::labs(2 * long(starts[h]) - long(n - 1)) <= limit) {
+                ++central[mot];
+              }
+              dist[mot] += std::fabs(r);
+            }
+            hits[mot] += starts.size();
+            expected[mot] += starts.size() * p;
+          }
+
+        }
+
+      }, nthreads);
+
+  Rcpp::NumericMatrix hist(nmots, nbins);
+  vec_num_t hits(nmots, 0), central(nmots, 0), expected(nmots, 0),
+            mean_dist(nmots, 0), pvals(nmots, 1);
+  bool has_na = false;
+  for (std::size_t b = 0; b < nbatches; ++b) {
+    for (int m = 0; m < nmots; ++m) {
+      hits[m] += batch_hits[b][m];
+      central[m] += batch_central[b][m];
+      expected[m] += batch_expected[b][m];
+      mean_dist[m] += batch_dist[b][m];
+      for (int j = 0; j < nbins; ++j) {
+        hist(m, j) += batch_hist[b][m * nbins + j];
+      }
+    }
+    if (batch_na[b]) has_na = true;
+  }
+
+  for (int m = 0; m < nmots; ++m) {
+    if (hits[m] == 0) {
+      mean_dist[m] = NA_REAL;
+      continue;
+    }
+    mean_dist[m] /= hits[m];
+    pvals[m] = binomial_upper(central[m], hits[m], expected[m] / hits[m]);
+  }
+
+  return Rcpp::List::create(
+        Rcpp::_["hist"] = hist,
+        Rcpp::_["hits"] = hits,
+        Rcpp::_["central"] = central,
+        Rcpp::_["expected"] = expected,
+        Rcpp::_["mean.dist"] = mean_dist,
+        Rcpp::_["pvals"] = pvals,
+        Rcpp::_["has.NA"] = has_na
+      );
+
+}
@@ -0,0 +1,23 @@
+#ifndef _SCAN_SEQUENCES_
+#define _SCAN_SEQUENCES_
+
+#include "types.h"
+
+/* Motifs are scanned as integer score matrices (scores times 1000) flattened
+ * column by column, with nrow scores per column, over sequences of k-let
+ * indices where -1 marks k-lets with non-standard letters. */
+
+void klet_indices_NA(const vec_int_t &seq_ints, vec_int_t &klets,
+    const int &k, const int &alphlen);
+
+void scan_hit_starts(const vec_int_t &motif_col_flat, const std::size_t &mlen,
+    const std::size_t &nrow, const vec_int_t &klets, const int &min_score,
+    vec_int_t &starts);
+
+/* highest scoring position; false if the sequence is shorter than the
+ * motif */
+bool scan_best_hit(const vec_int_t &motif_col_flat, const std::size_t &mlen,
+    const std::size_t &nrow, const vec_int_t &klets, int &best_score,
+    std::size_t &best_start);
+
+#endif
@@ -2,195 +2,186 @@
 #include <RcppThread.h>
 #include <cmath>
 #include <random>
-#include <set>
+#include <numeric>
+#include <algorithm>
+#include <fstream>
 #include "types.h"
 #include "utils-internal.h"
+#include "rng.h"
+#include "shuffle_sequences.h"
+#include "get_bkg.h"
 
-enum COMPARE_METRICS {
-  METHOD_EULER  = 1,
-  METHOD_MARKOV = 2,
-  METHOD_LINEAR = 3,
-  METHOD_K1     = 4
-};
+const std::size_t EULER_BATCH_SIZE = 256;
+const std::size_t LOCAL_BATCH_LETTERS = 65536;
+const std::size_t FASTA_LINE_WIDTH = 80;
+const std::size_t FASTA_SEGMENT_LINES = 65536;
+const std::size_t FASTA_BATCH_SIZE = 64;
 
-vec_int_t klet_counter(const vec_int_t &single_seq, const int &k,
-    const std::size_t &nlets, const std::size_t &alphlen) {
+std::string encode_seq(const std::string &single_seq, vec_int_t &seq_ints,
+    vec_int_t &lookup) {
 
-  vec_int_t klet_counts(nlets, 0);
-  int l, counter;
+  // Alphabet is the sorted set of letters present in the sequence; letters are
+  // recoded as 0..(alphlen - 1) using a char lookup table instead of a std::set.
 
-  for (std::size_t i = 0; i < single_seq.size() - k + 1; ++i) {
-    l = 0; counter = 0;
-    for (int j = k - 1; j >= 0; --j) {
-      l += pow(alphlen, j) * single_seq[i + counter];
-      ++counter;
-    }
-    ++klet_counts[l];
+  lookup.assign(256, -1);
+  for (std::size_t i = 0; i < single_seq.size(); ++i) {
+    lookup[(unsigned char)single_seq[i]] = 0;
   }
 
-  return klet_counts;
-
-}
-
-int get_lastlet(const vec_int_t &single_seq, const int &k,
-    const std::size_t &alphlen) {
+  std::string alph;
+  for (int i = 0; i < 256; ++i) {
+    if (lookup[i] == 0) alph += char(i);
+  }
+  for (std::size_t i = 0; i < alph.size(); ++i) {
+    lookup[(unsigned char)alph[i]] = i;
+  }
 
-  int lastlet = 0;
-  for (int i = k - 2; i >= 0; --i) {
-    lastlet += pow(alphlen, i) * single_seq[single_seq.size() - 1 - i];
+  seq_ints.resize(single_seq.size());
+  for (std::size_t i = 0; i < single_seq.size(); ++i) {
+    seq_ints[i] = lookup[(unsigned char)single_seq[i]];
   }
 
-  return lastlet;
+  return alph;
 
 }
 
-vec_int_t get_firstlet(const vec_int_t &single_seq, const int &k) {
+bool euler_graph_ints(const vec_int_t &seq_ints, const std::size_t &start,
+    const std::size_t &len, const std::size_t &alphlen, const int &k,
+    shuffle_scratch_t &scratch) {
 
-  vec_int_t firstlet;
-  firstlet.reserve(k - 1);
-
-  for (int i = 0; i < k - 1; ++i) {
-    firstlet.push_back(single_seq[i]);
-  }
+  // Altschul and Erickson (1985) k-let graph of seq_ints[start, start + len).
+  // Vertices are (k-1)-lets tracked with a rolling index, and the edge counts
+  // are simply the k-let counts. Returns false if there is nothing to shuffle.
 
-  return firstlet;
+  if (len <= std::size_t(k) || alphlen < 2) return false;
 
-}
+  std::size_t mlets = 1;
+  for (int i = 0; i < k - 1; ++i) mlets *= alphlen;
+  std::size_t nlets = mlets * alphlen;
 
-list_int_t get_edgecounts(const vec_int_t &klet_counts, const std::size_t &mlets,
-    const std::size_t &alphlen) {
+  vec_int_t &klet_counts = scratch.klet_counts;
+  vec_int_t &degree = scratch.degree;
 
-  list_int_t edgecounts(mlets, vec_int_t(alphlen));
-  std::size_t counter = 0;
+  klet_counts.assign(nlets, 0);
+  degree.assign(mlets, 0);
 
-  for (std::size_t i = 0; i < mlets; ++i) {
-    for (std::size_t j = 0; j < alphlen; ++j) {
-      edgecounts[i][j] = klet_counts[counter];
-      ++counter;
-    }
+  std::size_t firstlet = 0;
+  for (int i = 0; i < k - 1; ++i) {
+    firstlet = firstlet * alphlen + seq_ints[start + i];
   }
 
-  return edgecounts;
-
-}
-
-vec_bool_t get_emptyvertices(const std::size_t &mlets, const std::size_t &alphlen,
-    const list_int_t &edgelist) {
-
-  vec_bool_t emptyvertices;
-  emptyvertices.reserve(mlets);
+  std::size_t l = klet_count_ints(seq_ints, start, len, k, alphlen,
+      klet_counts);
 
   for (std::size_t i = 0; i < mlets; ++i) {
-    emptyvertices.push_back(true);
     for (std::size_t j = 0; j < alphlen; ++j) {
-      if (edgelist[i][j] > 0) {
-        emptyvertices[i] = false;
-        break;
-      }
+      degree[i] += klet_counts[i * alphlen + j];
     }
   }
 
-  return emptyvertices;
+  scratch.mlets = mlets;
+  scratch.firstlet = firstlet;
+  scratch.lastlet = l;
+
+  return true;
 
 }
 
-vec_int_t get_eulerpath(const list_int_t &edgelist, const int &lastlet,
-    const std::size_t &mlets, const std::size_t &alphlen, const int &k,
-    const vec_bool_t &emptyvertices, std::mt19937 gen) {
+void euler_walk_ints(vec_int_t &out_ints, const std::size_t &start,
+    const std::size_t &len, const std::size_t &alphlen, const int &k,
+    rng_t &gen, shuffle_scratch_t &scratch) {
 
-  vec_int_t eulerpath(mlets, 0);
-  vec_bool_t vertices(mlets, false);
-  vec_int_t next_index(mlets);
-  int counter = 0, vertex_ok = 0;
-  std::size_t mmlets = pow(alphlen, k - 2);
-  int u;
+  // One random Eulerian walk through the graph from euler_graph_ints(). The
+  // first k-1 letters of out_ints[start, start + len) must already be set
+  // (they are the same as in the input); the rest is overwritten.
 
-  vertices[lastlet] = true;
+  std::size_t mlets = scratch.mlets, lastlet = scratch.lastlet;
 
-  for (std::size_t i = 0; i < mlets; ++i) {
-    next_index[i] = counter * alphlen;
-    if (counter == int(mmlets) - 1)
-      counter = 0;
-    else
-      ++counter;
-  }
+  vec_int_t &edgecounts = scratch.edgecounts;
+  vec_int_t &degree = scratch.degree;
+  vec_int_t &eulerpath = scratch.eulerpath;
+  vec_int_t &edge_start = scratch.edge_start;
+  vec_int_t &edge_index = scratch.edge_index;
+  vec_int_t &edges = scratch.edges;
+  vec_bool_t &visited = scratch.visited;
+
+  edgecounts.assign(scratch.klet_counts.begin(), scratch.klet_counts.end());
+  eulerpath.assign(mlets, 0);
+  visited.assign(mlets, false);
 
   for (std::size_t i = 0; i < mlets; ++i) {
-    if (emptyvertices[i])
-      vertices[i] = true;
-    else
-      ++vertex_ok;
+    if (degree[i] == 0) visited[i] = true;
   }
+  visited[lastlet] = true;
 
-  for (std::size_t i = 0; i < mlets; ++i) {
+  // Random spanning tree of last exits towards lastlet via cycle-popping
+  // (Propp and Wilson 1998): pick a random edge out of each vertex, weighted
+  // by edge counts, until a visited vertex is reached.
 
+  std::size_t u;
+  int r;
+  for (std::size_t i = 0; i < mlets; ++i) {
     u = i;
-
-    while (!vertices[u]) {
-      std::discrete_distribution<int> next_u(edgelist[u].begin(), edgelist[u].end());
-      eulerpath[u] = next_u(gen);
-      u = k == 2 ? eulerpath[u] : eulerpath[u] + next_index[u];
+    while (!visited[u]) {
+      r = gen.below(degree[u]);
+      for (std::size_t j = 0; j < alphlen; ++j) {
+        r -= edgecounts[u * alphlen + j];
+        if (r < 0) {
+          eulerpath[u] = j;
+          break;
+        }
+      }
+      u = (u * alphlen + eulerpath[u]) % mlets;
     }
-
     u = i;
-
-    while (!vertices[u]) {
-      vertices[u] = true;
-      u = k == 2 ? eulerpath[u] : eulerpath[u] + next_index[u];
+    while (!visited[u]) {
+      visited[u] = true;
+      u = (u * alphlen + eulerpath[u]) % mlets;
     }
-
   }
 
-  return eulerpath;
-
-}
-
-list_int_t get_edgelist(const list_int_t &edgecounts, const vec_int_t &eulerpath,
-    const std::size_t &mlets, const std::size_t &alphlen, const int &lastlet,
-    std::mt19937 gen, const vec_bool_t &emptyvertices) {
+  // Remaining edges of each vertex are shuffled, with the last exit edge kept
+  // at the end.
 
-  list_int_t edgelist(mlets);
-  int b;
+  edge_start.assign(mlets + 1, 0);
+  for (std::size_t i = 0; i < mlets; ++i) {
+    edge_start[i + 1] = edge_start[i] + degree[i];
+  }
+  edges.resize(edge_start[mlets]);
+  edge_index.assign(edge_start.begin(), edge_start.end() - 1);
 
+  int b, e;
   for (std::size_t i = 0; i < mlets; ++i) {
-    if (emptyvertices[i]) continue;
-    edgelist[i].reserve(std::accumulate(edgecounts[i].begin(), edgecounts[i].end(), 0));
-    for (int j = 0; j < int(alphlen); ++j) {
-      b = edgecounts[i][j];
+    if (degree[i] == 0) continue;
+    if (i != lastlet) --edgecounts[i * alphlen + eulerpath[i]];
+    e = edge_start[i];
+    for (std::size_t j = 0; j < alphlen; ++j) {
+      b = edgecounts[i * alphlen + j];
       for (int h = 0; h < b; ++h) {
-        edgelist[i].push_back(j);
+        edges[e] = j;
+        ++e;
       }
     }
-    std::shuffle(edgelist[i].begin(), edgelist[i].end(), gen);
-    if (int(i) != lastlet) edgelist[i].push_back(eulerpath[i]);
+    std::shuffle(edges.begin() + edge_start[i], edges.begin() + e, gen);
+    if (i != lastlet) edges[e] = eulerpath[i];
   }
 
-  return edgelist;
+  u = scratch.firstlet;
+  for (std::size_t i = k - 1; i < len; ++i) {
+    out_ints[start + i] = edges[edge_index[u]];
+    ++edge_index[u];
+    u = u * alphlen + out_ints[start + i] - out_ints[start + i - k + 1] * mlets;
+  }
 
 }
 
-vec_int_t eulerian_walk(const list_int_t &edgelist, const std::size_t &seqlen,
-    const vec_int_t &firstlet, const std::size_t &mlets, const std::size_t &alphlen) {
+void shuffle_euler_ints(vec_int_t &seq_ints, const std::size_t &start,
+    const std::size_t &len, const std::size_t &alphlen, const int &k,
+    rng_t &gen, shuffle_scratch_t &scratch) {
 
-  vec_int_t shuffled_seq_ints;
-  shuffled_seq_ints.reserve(seqlen);
-  vec_int_t edge_index(mlets, 0);
-  int which_vertex;
-
-  for (std::size_t i = 0; i < firstlet.size(); ++i) {
-    shuffled_seq_ints.push_back(firstlet[i]);
-  }
-
-  for (std::size_t i = firstlet.size() - 1; i < seqlen - 1; ++i) {
-    which_vertex = 0;
-    for (int j = int(firstlet.size()) - 1; j >= 0; --j) {
-      which_vertex += pow(alphlen, j) * (shuffled_seq_ints[i - j] % alphlen);
-    }
-    shuffled_seq_ints.push_back(edgelist[which_vertex][edge_index[which_vertex]]);
-    ++edge_index[which_vertex];
-  }
-
-  return shuffled_seq_ints;
+  /* in place: the walk only reads the graph, not the input letters */
+  if (euler_graph_ints(seq_ints, start, len, alphlen, k, scratch))
+    euler_walk_ints(seq_ints, start, len, alphlen, k, gen, scratch);
 
 }
 
@@ -208,165 +199,154 @@ std::string make_new_seq(const vec_int_t &shuffled_seq_ints,
 
 }
 
-std::string shuffle_euler_one(const std::string &single_seq, const int &k,
-    std::mt19937 gen) {
+void alias_setup(const vec_num_t &weights, vec_num_t &prob, vec_int_t &alias,
+    const std::size_t &offset) {
 
-  std::set<int> alph_s;
-  for (std::size_t i = 0; i < single_seq.size(); ++i) {
-    alph_s.insert(single_seq[i]);
-  }
-  std::string alph;
-  alph.assign(alph_s.begin(), alph_s.end());
-  std::size_t alphlen = alph.size();
-  std::size_t nlets = pow(alph.size(), k);
-  std::size_t mlets = pow(alph.size(), k - 1);
+  // Vose's alias method: after this O(n) setup, each draw is a single uniform
+  // number plus one comparison. An all-zero set of weights always returns the
+  // first letter, same as std::discrete_distribution.
 
-  vec_int_t seq_ints(single_seq.size());
-  for (std::size_t i = 0; i < single_seq.size(); ++i) {
-    for (std::size_t a = 0; a < alph.size(); ++a) {
-      if (single_seq[i] == alph[a]) {
-        seq_ints[i] = a;
-        break;
-      }
+  std::size_t n = weights.size();
+  double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+
+  if (total <= 0) {
+    for (std::size_t i = 0; i < n; ++i) {
+      prob[offset + i] = 0.0;
+      alias[offset + i] = 0;
     }
+    prob[offset] = 1.0;
+    return;
+  }
+
+  vec_num_t scaled(n);
+  vec_int_t small, large;
+  small.reserve(n);
+  large.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    scaled[i] = weights[i] * double(n) / total;
+    if (scaled[i] < 1.0)
+      small.push_back(i);
+    else
+      large.push_back(i);
+  }
+
+  int s, l;
+  while (!small.empty() && !large.empty()) {
+    s = small.back(); small.pop_back();
+    l = large.back(); large.pop_back();
+    prob[offset + s] = scaled[s];
+    alias[offset + s] = l;
+    scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+    if (scaled[l] < 1.0)
+      small.push_back(l);
+    else
+      large.push_back(l);
   }
 
-  vec_int_t klet_counts = klet_counter(seq_ints, k, nlets, alphlen);
-  vec_int_t firslet = get_firstlet(seq_ints, k);
-  int lastlet = get_lastlet(seq_ints, k, alphlen);
-  list_int_t edgecounts = get_edgecounts(klet_counts, mlets, alphlen);
-  vec_bool_t emptyvertices = get_emptyvertices(mlets, alphlen, edgecounts);
-  vec_int_t eulerpath = get_eulerpath(edgecounts, lastlet, mlets, alphlen, k,
-      emptyvertices, gen);
-
-  for (std::size_t i = 0; i < eulerpath.size(); ++i) {
-    if (int(i) != lastlet) --edgecounts[i][eulerpath[i]];
+  /* leftovers are only off from 1 due to rounding error */
+  for (std::size_t i = 0; i < large.size(); ++i) {
+    prob[offset + large[i]] = 1.0;
+    alias[offset + large[i]] = large[i];
+  }
+  for (std::size_t i = 0; i < small.size(); ++i) {
+    prob[offset + small[i]] = 1.0;
+    alias[offset + small[i]] = small[i];
   }
 
-  list_int_t edgelist = get_edgelist(edgecounts, eulerpath, mlets, alphlen,
-      lastlet, gen, emptyvertices);
+}
 
-  vec_int_t shuffled_seq_ints = eulerian_walk(edgelist, single_seq.size(),
-      firslet, mlets, alphlen);
+int alias_draw(const vec_num_t &prob, const vec_int_t &alias,
+    const std::size_t &offset, const std::size_t &n, rng_t &gen) {
 
-  std::string out = make_new_seq(shuffled_seq_ints, alph);
-  return out;
+  double u = gen.uniform() * double(n);
+  std::size_t i = u;
+  if (i >= n) i = n - 1;
+  return u - double(i) < prob[offset + i] ? int(i) : alias[offset + i];
 
 }
 
-list_int_t make_klet_lists(const std::size_t &nlets, const int &k,
-    const std::size_t &alphlen) {
+void markov_tables(const list_num_t &transitions, const std::size_t &alphlen,
+    vec_num_t &prob, vec_int_t &alias) {
 
-  list_int_t klet_list(nlets);
-  for (std::size_t i = 0; i < nlets; ++i) {
-    klet_list[i].reserve(k);
+  prob.assign(transitions.size() * alphlen, 0.0);
+  alias.assign(transitions.size() * alphlen, 0);
+  for (std::size_t i = 0; i < transitions.size(); ++i) {
+    alias_setup(transitions[i], prob, alias, i * alphlen);
   }
-  int counter, let, step;
-
-  for (int i = k - 1; i >= 0; --i) {
-    counter = 0;
-    let = 0;
-    step = pow(alphlen, i);
-    while (counter < int(nlets)) {
-      for (int j = 0; j < step; ++j) {
-        klet_list[counter].push_back(let);
-        ++counter;
-      }
-      if (let == int(alphlen) - 1)
-        let = 0;
-      else
-        ++let;
-    }
-  }
-
-  return klet_list;
 
 }
 
-/*
-vec_int_t get_next_let_list(const list_int_t &nlet_lists, const int &k,
-    const std::size_t &alphlen, const std::size_t &nlets) {
+void markov_setup(const vec_int_t &nlet_counts, const std::size_t &alphlen,
+    vec_num_t &first_prob, vec_int_t &first_alias, vec_num_t &trans_prob,
+    vec_int_t &trans_alias) {
 
-  vec_int_t out(nlets, 0);
+  std::size_t nlets = nlet_counts.size(), mlets = nlets / alphlen;
 
-  for (std::size_t i = 0; i < nlets; ++i) {
-    for (int j = 0; j < k; ++j) {
-      out[i] += nlet_lists[i][j] * pow(alphlen, k - j - 1);
+  first_prob.assign(nlets, 0.0);
+  first_alias.assign(nlets, 0);
+  alias_setup(vec_num_t(nlet_counts.begin(), nlet_counts.end()), first_prob,
+      first_alias, 0);
+
+  list_num_t trans(mlets, vec_num_t(alphlen));
+  for (std::size_t i = 0; i < mlets; ++i) {
+    for (std::size_t j = 0; j < alphlen; ++j) {
+      trans[i][j] = nlet_counts[i * alphlen + j];
     }
   }
-
-  return out;
+  markov_tables(trans, alphlen, trans_prob, trans_alias);
 
 }
-*/
 
-vec_int_t markov_generator(const std::size_t &seqsize, const vec_int_t &nlet_counts,
-    const list_int_t &transitions, std::mt19937 gen,
-    const std::size_t &nlets, const int &k, const std::size_t &alphlen) {
+void markov_generator(vec_int_t &out, const std::size_t &start,
+    const std::size_t &len, const vec_num_t &first_prob,
+    const vec_int_t &first_alias, const vec_num_t &trans_prob,
+    const vec_int_t &trans_alias, const int &k, const std::size_t &alphlen,
+    rng_t &gen) {
 
-  vec_int_t out;
-  out.reserve(seqsize);
+  // Fills out[start, start + len).
 
-  list_int_t nlet_lists = make_klet_lists(nlets, k, alphlen);
+  std::size_t nlets = first_prob.size(), mlets = nlets / alphlen;
 
-  std::discrete_distribution<int> first_gen(nlet_counts.begin(), nlet_counts.end());
-  int firstletters = first_gen(gen);
-  for (int i = 0; i < k; ++i) {
-    out.push_back(nlet_lists[firstletters][i]);
+  int firstletters = alias_draw(first_prob, first_alias, 0, nlets, gen);
+  std::size_t nfirst = std::min(std::size_t(k), len);
+  for (int i = k - 1, l = firstletters; i >= 0; --i, l /= alphlen) {
+    if (std::size_t(i) < nfirst) out[start + i] = l % alphlen;
   }
 
-  int previous_mlet;
-  for (std::size_t i = k - 1; i < seqsize - 1; ++i) {
-    previous_mlet = 0;
-    for (int j = k - 1; j >= 1; --j) {
-      previous_mlet += out[i - j] * pow(alphlen, j - 1);
-    }
-    std::discrete_distribution<int> next_gen(transitions[previous_mlet].begin(),
-        transitions[previous_mlet].end());
-    out.push_back(next_gen(gen));
+  /* rolling index of the previous (k-1)-let */
+  std::size_t mlet = firstletters % mlets;
+  int next;
+  for (std::size_t i = nfirst; i < len; ++i) {
+    next = alias_draw(trans_prob, trans_alias, mlet * alphlen, alphlen, gen);
+    out[start + i] = next;
+    mlet = (mlet * alphlen + next) % mlets;
   }
 
-  return out;
-
 }
 
-std::string shuffle_markov_one(const std::string &single_seq, const int &k,
-    std::mt19937 gen) {
-
-  std::set<int> alph_s;
-  for (std::size_t i = 0; i < single_seq.size(); ++i) {
-    alph_s.insert(single_seq[i]);
-  }
-  std::string alph;
-  alph.assign(alph_s.begin(), alph_s.end());
-  std::size_t alphlen = alph.size();
-  std::size_t nlets = pow(alphlen, k);
-  std::size_t mlets = pow(alphlen, k - 1);
+void shuffle_markov_ints(vec_int_t &seq_ints, const std::size_t &start,
+    const std::size_t &len, const std::size_t &alphlen, const int &k,
+    rng_t &gen) {
 
-  vec_int_t seq_ints(single_seq.size());
-  for (std::size_t i = 0; i < single_seq.size(); ++i) {
-    for (std::size_t a = 0; a < alphlen; ++a) {
-      if (single_seq[i] == alph[a]) {
-        seq_ints[i] = a;
-        break;
-      }
-    }
-  }
+  if (len < std::size_t(k) || alphlen < 2) return;
 
-  vec_int_t nlet_counts = klet_counter(seq_ints, k, nlets, alphlen);
-  list_int_t transitions = get_edgecounts(nlet_counts, mlets, alphlen);
+  std::size_t nlets = pow(alphlen, k);
 
-  vec_int_t out_ints = markov_generator(seq_ints.size(), nlet_counts, transitions,
-      gen, nlets, k, alphlen);
+  vec_int_t nlet_counts(nlets, 0);
+  klet_count_ints(seq_ints, start, len, k, alphlen, nlet_counts);
 
-  std::string out = make_new_seq(out_ints, alph);
+  vec_num_t first_prob, trans_prob;
+  vec_int_t first_alias, trans_alias;
+  markov_setup(nlet_counts, alphlen, first_prob, first_alias, trans_prob,
+      trans_alias);
 
-  return out;
+  markov_generator(seq_ints, start, len, first_prob, first_alias, trans_prob,
+      trans_alias, k, alphlen, gen);
 
 }
 
 std::string shuffle_linear_one(const std::string &single_seq, const int &k,
-    std::mt19937 gen) {
+    rng_t &gen) {
 
   std::size_t seqlen = single_seq.size();
   std::size_t seqlen_k = seqlen / k;
@@ -402,26 +382,12 @@ std::string shuffle_linear_one(const std::string &single_seq, const int &k,
 
 vec_int_t klet_counter_from_string(const str_t &single_seq, const int &k) {
 
-  std::set<int> alph_s;
-  for (std::size_t i = 0; i < single_seq.size(); ++i) {
-    alph_s.insert(single_seq[i]);
-  }
-  str_t alph;
-  alph.assign(alph_s.begin(), alph_s.end());
-  std::size_t alphlen = alph.size();
+  vec_int_t seq_ints, lookup;
+  std::size_t alphlen = encode_seq(single_seq, seq_ints, lookup).size();
   std::size_t nlets = pow(alphlen, k);
 
-  vec_int_t seq_ints(single_seq.size());
-  for (std::size_t i = 0; i < single_seq.size(); ++i) {
-    for (std::size_t a = 0; a < alphlen; ++a) {
-      if (single_seq[i] == alph[a]) {
-        seq_ints[i] = a;
-        break;
-      }
-    }
-  }
-
-  vec_int_t counts = klet_counter(seq_ints, k, nlets, alphlen);
+  vec_int_t counts(nlets, 0);
+  klet_count_ints(seq_ints, 0, seq_ints.size(), k, alphlen, counts);
 
   return counts;
 
@@ -453,51 +419,148 @@ vec_str_t get_klet_strings(const vec_str_t &alph, const int &k) {
 
 }
 
-std::string shuffle_seq_local_one_sub(const std::string &single_seq,
-    const int &k, std::mt19937 gen, const int &method) {
-  switch (method) {
-    case METHOD_EULER: return shuffle_euler_one(single_seq, k, gen);
-    case METHOD_MARKOV: return shuffle_markov_one(single_seq, k, gen);
-    case METHOD_LINEAR: return shuffle_linear_one(single_seq, k, gen);
-    case METHOD_K1: std::string out = single_seq;
-                    shuffle(out.begin(), out.end(), gen);
-                    return out;
-  }
-  return single_seq;
+void shuffle_linear_ints(vec_int_t &seq_ints, const std::size_t &start,
+    const std::size_t &len, const int &k, rng_t &gen, vec_int_t &tmp) {
+
+  std::size_t len_k = len / k;
+
+  vec_int_t indices(len_k);
+  for (std::size_t i = 0; i < len_k; ++i) {
+    indices[i] = i * k;
+  }
+  std::shuffle(indices.begin(), indices.end(), gen);
+
+  tmp.assign(seq_ints.begin() + start, seq_ints.begin() + start + len_k * k);
+  for (std::size_t i = 0; i < len_k; ++i) {
+    for (int j = 0; j < k; ++j) {
+      seq_ints[start + i * k + j] = tmp[indices[i] + j];
+    }
+  }
+
 }
 
-std::string shuffle_seq_local_one(const std::string &single_seq, const int &k,
-    std::mt19937 gen, const std::vector<int> &starts, const std::vector<int> &stops,
-    const int &method) {
+void shuffle_local_ints(vec_int_t &seq_ints, const std::size_t &start,
+    const std::size_t &len, const std::size_t &alphlen, const int &k,
+    const int &method, rng_t &gen, shuffle_scratch_t &scratch) {
 
-  std::string out = single_seq;
+  // Shuffle seq_ints[start, start + len) in place. The alphabet is that of the
+  // whole sequence; letters missing from the window simply have no k-lets.
 
-  for (std::size_t i = 0; i < starts.size(); ++i) {
-    std::size_t pos = starts[i] - 1;
-    std::size_t len = stops[i] - starts[i] + 1;
-    std::string tmp = shuffle_seq_local_one_sub(out.substr(pos, len), k, gen, method);
-    out.replace(pos, len, tmp);
+  switch (method) {
+    case METHOD_EULER:
+      shuffle_euler_ints(seq_ints, start, len, alphlen, k, gen, scratch);
+      break;
+    case METHOD_MARKOV:
+      shuffle_markov_ints(seq_ints, start, len, alphlen, k, gen);
+      break;
+    case METHOD_LINEAR:
+      shuffle_linear_ints(seq_ints, start, len, k, gen, scratch.tmp);
+      break;
+    case METHOD_K1:
+      std::shuffle(seq_ints.begin() + start, seq_ints.begin() + start + len, gen);
+      break;
   }
 
-  return out;
+}
+
+void create_seq_segment(std::string &out, const std::size_t &from,
+    const std::size_t &to, const vec_str_t &alph, const int &k,
+    const vec_num_t &first_prob, const vec_int_t &first_alias,
+    const vec_num_t &trans_prob, const vec_int_t &trans_alias, rng_t &gen,
+    std::size_t &mlet) {
+
+  // Appends letters [from, to) of a generated sequence to out. Long sequences
+  // can be made in several segments, as long as gen and the rolling
+  // (k-1)-let index mlet are carried over from one segment to the next.
+
+  std::size_t alphlen = alph.size(), nlets = first_prob.size();
+  std::size_t mlets = nlets / alphlen, pos = from;
+
+  if (pos == 0 && to > 0) {
+    std::size_t firstletters = alias_draw(first_prob, first_alias, 0, nlets, gen);
+    vec_int_t first(k);
+    std::size_t l = firstletters;
+    for (int j = k - 1; j >= 0; --j, l /= alphlen) {
+      first[j] = l % alphlen;
+    }
+    for (int j = 0; j < k && pos < to; ++j, ++pos) {
+      out += alph[first[j]];
+    }
+    mlet = firstletters % mlets;
+  }
+
+  int next;
+  if (k == 1) {
+    for (; pos < to; ++pos) {
+      out += alph[alias_draw(first_prob, first_alias, 0, alphlen, gen)];
+    }
+  } else {
+    for (; pos < to; ++pos) {
+      next = alias_draw(trans_prob, trans_alias, mlet * alphlen, alphlen, gen);
+      out += alph[next];
+      mlet = (mlet * alphlen + next) % mlets;
+    }
+  }
 
 }
 
+void create_seq_tables(const std::size_t &alphlen, const int &k,
+    const vec_num_t &freqs, const list_num_t &transitions,
+    vec_num_t &first_prob, vec_int_t &first_alias, vec_num_t &trans_prob,
+    vec_int_t &trans_alias) {
+
+  std::size_t nlets = pow(alphlen, k);
+
+  first_prob.assign(nlets, 0.0);
+  first_alias.assign(nlets, 0);
+  alias_setup(freqs, first_prob, first_alias, 0);
+  if (k > 1) markov_tables(transitions, alphlen, trans_prob, trans_alias);
+
+}
 
 /* C++ ENTRY ---------------------------------------------------------------- */
 
 // [[Rcpp::export(rng = false)]]
 std::vector<std::string> shuffle_markov_cpp(const std::vector<std::string> &sequences,
-    const int &k, const int &nthreads, const int &seed) {
-
-  unsigned int useed = seed;
+    const int &k, const int &nthreads, const int &seed, const int &reps = 1) {
 
-  vec_str_t out(sequences.size());
-  RcppThread::parallelFor(0, sequences.size(),
-      [&out, &sequences, &useed, &k] (std::size_t i) {
+  // Replicates are returned replicate-major: out[r * nseqs + i]. The k-let
+  // counts and samplers of each sequence are only built once. Sequences
+  // shorter than k or with fewer than two letters are returned unchanged, as
+  // by shuffle_markov_ints().
 
-        std::mt19937 gen(useed * (int(i) + 1));
-        out[i] = shuffle_markov_one(sequences[i], k, gen);
+  unsigned int useed = seed;
+  std::size_t nseqs = sequences.size();
+
+  vec_str_t out(nseqs * reps);
+  RcppThread::parallelFor(0, nseqs,
+      [&out, &sequences, &useed, &k, &reps, &nseqs] (std::size_t i) {
+
+        vec_int_t seq_ints, lookup;
+        std::string alph = encode_seq(sequences[i], seq_ints, lookup);
+        std::size_t alphlen = alph.size();
+        if (seq_ints.size() < std::size_t(k) || alphlen < 2) {
+          for (int r = 0; r < reps; ++r) {
+            out[r * nseqs + i] = sequences[i];
+          }
+          return;
+        }
+        std::size_t nlets = pow(alphlen, k);
+
+        vec_num_t first_prob, trans_prob;
+        vec_int_t first_alias, trans_alias;
+        vec_int_t nlet_counts(nlets, 0);
+        klet_count_ints(seq_ints, 0, seq_ints.size(), k, alphlen, nlet_counts);
+        markov_setup(nlet_counts, alphlen, first_prob, first_alias, trans_prob,
+            trans_alias);
+
+        vec_int_t rep_ints(seq_ints.size());
+        for (int r = 0; r < reps; ++r) {
+          rng_t gen(useed, r * nseqs + i);
+          markov_generator(rep_ints, 0, rep_ints.size(), first_prob,
+              first_alias, trans_prob, trans_alias, k, alphlen, gen);
+          out[r * nseqs + i] = make_new_seq(rep_ints, alph);
+        }
 
       }, nthreads);
 
@@ -507,16 +570,48 @@ std::vector<std::string> shuffle_markov_cpp(const std::vector<std::string> &sequ
 
 // [[Rcpp::export(rng = false)]]
 std::vector<std::string> shuffle_euler_cpp(const std::vector<std::string> &sequences,
-    const int &k, const int &nthreads, const int &seed) {
+    const int &k, const int &nthreads, const int &seed, const int &reps = 1) {
 
-  unsigned int useed = seed;
+  // Replicates are returned replicate-major: out[r * nseqs + i]. The k-let
+  // graph of each sequence is only built once.
 
-  vec_str_t out(sequences.size());
-  RcppThread::parallelFor(0, sequences.size(),
-      [&out, &sequences, &k, &useed] (std::size_t i) {
+  unsigned int useed = seed;
+  std::size_t nseqs = sequences.size();
+
+  /* sequences are processed in batches which share a set of working buffers;
+   * the batches are kept small enough for every thread to get some */
+  std::size_t batch_size = parallel_batch_size(nseqs, nthreads,
+      EULER_BATCH_SIZE);
+  std::size_t nbatches = (nseqs + batch_size - 1) / batch_size;
+
+  vec_str_t out(nseqs * reps);
+  RcppThread::parallelFor(0, nbatches,
+      [&out, &sequences, &k, &useed, &reps, &nseqs, &batch_size] (std::size_t b) {
+
+        shuffle_scratch_t scratch;
+        vec_int_t rep_ints;
+        std::size_t last = std::min((b + 1) * batch_size, nseqs);
+
+        for (std::size_t i = b * batch_size; i < last; ++i) {
+
+          std::string alph = encode_seq(sequences[i], scratch.seq_ints,
+              scratch.lookup);
+          std::size_t len = sequences[i].size();
+          bool ok = euler_graph_ints(scratch.seq_ints, 0, len, alph.size(), k,
+              scratch);
+
+          for (int r = 0; r < reps; ++r) {
+            if (!ok) {
+              out[r * nseqs + i] = sequences[i];
+              continue;
+            }
+            rng_t gen(useed, r * nseqs + i);
+            rep_ints.assign(scratch.seq_ints.begin(), scratch.seq_ints.end());
+            euler_walk_ints(rep_ints, 0, len, alph.size(), k, gen, scratch);
+            out[r * nseqs + i] = make_new_seq(rep_ints, alph);
+          }
 
-        std::mt19937 gen(useed * (int(i) + 1));
-        out[i] = shuffle_euler_one(sequences[i], k, gen);
+        }
 
       }, nthreads);
 
@@ -531,15 +626,78 @@ std::vector<std::string> shuffle_seq_local_cpp(const std::vector<std::string> &s
     const std::vector<std::vector<int>> &stops,
     const int &method) {
 
+  // Windows are shuffled in place on the encoded sequences. Windows which do
+  // not overlap are independent, so each sequence's windows are split into
+  // waves (window j goes into wave j % nwaves) in which no two windows
+  // overlap. Waves are applied one after the other, and all windows of a
+  // wave (from all sequences) are shuffled in parallel. With no overlap
+  // between windows there is a single wave. Each window has its own RNG
+  // stream, so results do not depend on nthreads.
+
   unsigned int useed = seed;
+  std::size_t nseqs = sequences.size();
+
+  list_int_t seq_ints(nseqs);
+  vec_str_t alphs(nseqs);
+  RcppThread::parallelFor(0, nseqs,
+      [&seq_ints, &alphs, &sequences] (std::size_t i) {
+        vec_int_t lookup;
+        alphs[i] = encode_seq(sequences[i], seq_ints[i], lookup);
+      }, nthreads);
 
-  vec_str_t out(sequences.size());
-  RcppThread::parallelFor(0, sequences.size(),
-      [&out, &sequences, &k, &useed, &starts, &stops, &method] (std::size_t i) {
+  vec_int_t nwaves(nseqs, 1), win_offset(nseqs + 1, 0);
+  std::size_t maxwaves = 1, d;
+  for (std::size_t i = 0; i < nseqs; ++i) {
+    for (std::size_t j = 0; j < starts[i].size(); ++j) {
+      d = 1;
+      while (j + d < starts[i].size() && starts[i][j + d] <= stops[i][j]) ++d;
+      if (int(d) > nwaves[i]) nwaves[i] = d;
+    }
+    if (std::size_t(nwaves[i]) > maxwaves) maxwaves = nwaves[i];
+    win_offset[i + 1] = win_offset[i] + starts[i].size();
+  }
+
+  for (std::size_t w = 0; w < maxwaves; ++w) {
+
+    /* windows of this wave, grouped into batches of roughly
+     * LOCAL_BATCH_LETTERS letters which share a set of working buffers */
+    vec_int_t task_seq, task_win, batch_start(1, 0);
+    std::size_t batch_letters = 0;
+    for (std::size_t i = 0; i < nseqs; ++i) {
+      for (std::size_t j = w; j < starts[i].size(); j += nwaves[i]) {
+        task_seq.push_back(i);
+        task_win.push_back(j);
+        batch_letters += stops[i][j] - starts[i][j] + 1;
+        if (batch_letters >= LOCAL_BATCH_LETTERS) {
+          batch_start.push_back(task_seq.size());
+          batch_letters = 0;
+        }
+      }
+    }
+    if (batch_start.back() != int(task_seq.size()))
+      batch_start.push_back(task_seq.size());
+
+    RcppThread::parallelFor(0, batch_start.size() - 1,
+        [&seq_ints, &alphs, &task_seq, &task_win, &batch_start, &starts,
+         &stops, &win_offset, &useed, &k, &method] (std::size_t b) {
+
+          shuffle_scratch_t scratch;
+          for (int t = batch_start[b]; t < batch_start[b + 1]; ++t) {
+            int i = task_seq[t], j = task_win[t];
+            rng_t gen(useed, win_offset[i] + j);
+            shuffle_local_ints(seq_ints[i], starts[i][j] - 1,
+                stops[i][j] - starts[i][j] + 1, alphs[i].size(), k, method,
+                gen, scratch);
+          }
 
-        std::mt19937 gen(useed * (int(i) + 1));
-        out[i] = shuffle_seq_local_one(sequences[i], k, gen, starts[i], stops[i], method);
+        }, nthreads);
 
+  }
+
+  vec_str_t out(nseqs);
+  RcppThread::parallelFor(0, nseqs,
+      [&out, &seq_ints, &alphs] (std::size_t i) {
+        out[i] = make_new_seq(seq_ints[i], alphs[i]);
       }, nthreads);
 
   return out;
@@ -556,7 +714,7 @@ std::vector<std::string> shuffle_linear_cpp(const std::vector<std::string> &sequ
   RcppThread::parallelFor(0, sequences.size(),
       [&out, &sequences, &k, &useed] (std::size_t i) {
 
-        std::mt19937 gen(useed * (int(i) + 1));
+        rng_t gen(useed, i);
         out[i] = shuffle_linear_one(sequences[i], k, gen);
 
       }, nthreads);
@@ -574,7 +732,7 @@ std::vector<std::string> shuffle_k1_cpp(const std::vector<std::string> &sequence
   vec_str_t out(sequences.size());
   RcppThread::parallelFor(0, sequences.size(),
       [&out, &sequences, &useed] (std::size_t i) {
-        std::mt19937 gen(useed * (int(i) + 1));
+        rng_t gen(useed, i);
         out[i] = sequences[i];
         shuffle(out[i].begin(), out[i].end(), gen);
       }, nthreads);
@@ -629,65 +787,110 @@ std::vector<std::string> create_sequences_cpp(const int seqlen,
 
   unsigned int useed = seed;
 
-  std::size_t alphlen = alph.size();
-  std::size_t nlets = pow(alphlen, k);
-  list_int_t nlet_lists = make_klet_lists(nlets, k, alphlen);
-
-  list_num_t trans = R_to_cpp_motif_num(transitions);
+  /* samplers are built once and shared (read-only) by all threads */
+  vec_num_t first_prob, trans_prob;
+  vec_int_t first_alias, trans_alias;
+  create_seq_tables(alph.size(), k, freqs, R_to_cpp_motif_num(transitions),
+      first_prob, first_alias, trans_prob, trans_alias);
 
   vec_str_t out(seqnum, "");
 
-  if (k == 1) {
-
-    RcppThread::parallelFor(0, out.size(),
-        [&seqlen, &alph, &useed, &out, &freqs] (std::size_t i) {
+  RcppThread::parallelFor(0, out.size(),
+      [&seqlen, &alph, &useed, &out, &first_prob, &first_alias, &trans_prob,
+       &trans_alias, &k]
+      (std::size_t i) {
 
-          out[i].reserve(seqlen);
-          std::mt19937 gen(useed * (int(i) + 1));
-          std::discrete_distribution<int> nextlet(freqs.begin(), freqs.end());
+        rng_t gen(useed, i);
+        std::size_t mlet = 0;
+        out[i].reserve(seqlen);
+        create_seq_segment(out[i], 0, seqlen, alph, k, first_prob, first_alias,
+            trans_prob, trans_alias, gen, mlet);
 
-          for (int j = 0; j < seqlen; ++j) {
-            out[i] += alph[nextlet(gen)];
-          }
-
-        }, nthreads);
+      }, nthreads);
 
-  } else if (k > 1) {
+  return out;
 
-    RcppThread::parallelFor(0, out.size(),
-        [&seqlen, &alph, &useed, &out, &freqs, &trans, &nlet_lists, &k, &alphlen]
-        (std::size_t i) {
+}
 
-          vec_int_t out_i;
-          out_i.reserve(seqlen);
-          std::mt19937 gen(useed * (int(i) + 1));
+// [[Rcpp::export(rng = false)]]
+void create_sequences_fasta_cpp(const std::string &file, const int seqlen,
+    const int seqnum, const std::vector<std::string> &alph, const int k,
+    const std::vector<double> &freqs, const int nthreads, const int seed,
+    const Rcpp::NumericMatrix &transitions) {
 
-          std::discrete_distribution<int> let1(freqs.begin(), freqs.end());
-          int firstletters = let1(gen);
-          for (int j = 0; j < k; ++j) {
-            out_i.push_back(nlet_lists[firstletters][j]);
-          }
+  // Same sequences as create_sequences_cpp(), written straight to a FASTA
+  // file. The size of every record is known in advance, so each sequence is
+  // written at its own offset by whichever thread generates it, in segments
+  // of FASTA_SEGMENT_LINES lines. Sequences are made in batches which share
+  // one file handle, sized so that every thread gets several. A single
+  // sequence is not split between threads, since each letter depends on the
+  // ones before it from the same random number stream. Memory use does not
+  // depend on seqlen or seqnum.
 
-          int prevmlet;
-          for (int j = k - 1; j < seqlen; ++j) {
-            prevmlet = 0;
-            for (int b = k - 1; b >= 1; --b) {
-              prevmlet += out_i[j - b] * pow(alphlen, b - 1);
+  unsigned int useed = seed;
+  std::size_t len = seqlen, nseqs = seqnum;
+
+  vec_num_t first_prob, trans_prob;
+  vec_int_t first_alias, trans_alias;
+  create_seq_tables(alph.size(), k, freqs, R_to_cpp_motif_num(transitions),
+      first_prob, first_alias, trans_prob, trans_alias);
+
+  std::size_t nlines = (len + FASTA_LINE_WIDTH - 1) / FASTA_LINE_WIDTH;
+  std::vector<std::uint64_t> offsets(nseqs + 1, 0);
+  for (std::size_t i = 0; i < nseqs; ++i) {
+    offsets[i + 1] = offsets[i] + std::to_string(i + 1).size() + 2
+      + len + nlines;
+  }
+
+  {
+    std::ofstream f(file, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!f) Rcpp::stop("could not open file for writing: " + file);
+  }
+
+  std::size_t batch_size = parallel_batch_size(nseqs, nthreads,
+      FASTA_BATCH_SIZE);
+  std::size_t nbatches = (nseqs + batch_size - 1) / batch_size;
+  vec_int_t batch_failed(nbatches, 0);
+
+  RcppThread::parallelFor(0, nbatches,
+      [&batch_failed, &file, &len, &nlines, &offsets, &nseqs, &alph, &useed,
+       &first_prob, &first_alias, &trans_prob, &trans_alias, &k, &batch_size]
+      (std::size_t b) {
+
+        std::fstream f(file, std::ios::in | std::ios::out | std::ios::binary);
+        std::size_t last = std::min((b + 1) * batch_size, nseqs);
+        std::string segment, lines;
+
+        for (std::size_t i = b * batch_size; i < last && f; ++i) {
+
+          f.seekp(offsets[i]);
+          f << '>' << i + 1 << '\n';
+
+          rng_t gen(useed, i);
+          std::size_t mlet = 0, from = 0, to;
+          while (from < len && f) {
+            to = std::min(from + FASTA_LINE_WIDTH * FASTA_SEGMENT_LINES, len);
+            segment.clear();
+            create_seq_segment(segment, from, to, alph, k, first_prob,
+                first_alias, trans_prob, trans_alias, gen, mlet);
+            lines.clear();
+            for (std::size_t j = 0; j < segment.size(); j += FASTA_LINE_WIDTH) {
+              lines.append(segment, j, FASTA_LINE_WIDTH);
+              lines += '\n';
             }
-            std::discrete_distribution<int> nextlet(trans[prevmlet].begin(),
-                trans[prevmlet].end());
-            out_i.push_back(nextlet(gen));
+            f.write(lines.data(), lines.size());
+            from = to;
           }
 
-          out[i].reserve(seqlen);
-          for (int j = 0; j < seqlen; ++j) {
-            out[i] += alph[out_i[j]];
-          }
+        }
 
-        }, nthreads);
+        if (f.is_open()) f.close();
+        if (f.fail()) batch_failed[b] = 1;
 
-  }
+      }, nthreads);
 
-  return out;
+  for (std::size_t b = 0; b < nbatches; ++b) {
+    if (batch_failed[b]) Rcpp::stop("could not write to file: " + file);
+  }
 
 }
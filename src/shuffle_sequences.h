@@ -2,10 +2,74 @@
 #define _SHUFFLE_SEQUENCES_
 
 #include "types.h"
+#include "rng.h"
+
+enum SHUFFLE_METHODS {
+  METHOD_EULER  = 1,
+  METHOD_MARKOV = 2,
+  METHOD_LINEAR = 3,
+  METHOD_K1     = 4
+};
+
+/* Working buffers for the shufflers. These are kept alive across sequences
+ * (one set per batch of sequences or windows) so that the k-let graph is not
+ * reallocated for every sequence. */
+struct shuffle_scratch_t {
+  vec_int_t lookup;
+  vec_int_t seq_ints;
+  vec_int_t klet_counts;
+  vec_int_t edgecounts;
+  vec_int_t degree;
+  vec_int_t eulerpath;
+  vec_int_t edge_start;
+  vec_int_t edge_index;
+  vec_int_t edges;
+  vec_bool_t visited;
+  vec_int_t tmp;
+  std::size_t mlets;
+  std::size_t firstlet;
+  std::size_t lastlet;
+};
 
 vec_str_t get_klet_strings(const vec_str_t &alph, const int &k);
 
-vec_int_t klet_counter(const vec_int_t &single_seq, const int &k,
-    const std::size_t &nlets, const std::size_t &alphlen);
+/* Vose alias tables: weights[i] is stored at prob/alias[offset + i] */
+void alias_setup(const vec_num_t &weights, vec_num_t &prob, vec_int_t &alias,
+    const std::size_t &offset);
+
+int alias_draw(const vec_num_t &prob, const vec_int_t &alias,
+    const std::size_t &offset, const std::size_t &n, rng_t &gen);
+
+/* Markov background sequences (see create_sequences_cpp()); transitions is
+ * only used if k > 1 */
+void create_seq_tables(const std::size_t &alphlen, const int &k,
+    const vec_num_t &freqs, const list_num_t &transitions,
+    vec_num_t &first_prob, vec_int_t &first_alias, vec_num_t &trans_prob,
+    vec_int_t &trans_alias);
+
+void create_seq_segment(std::string &out, const std::size_t &from,
+    const std::size_t &to, const vec_str_t &alph, const int &k,
+    const vec_num_t &first_prob, const vec_int_t &first_alias,
+    const vec_num_t &trans_prob, const vec_int_t &trans_alias, rng_t &gen,
+    std::size_t &mlet);
+
+std::string encode_seq(const std::string &single_seq, vec_int_t &seq_ints,
+    vec_int_t &lookup);
+
+bool euler_graph_ints(const vec_int_t &seq_ints, const std::size_t &start,
+    const std::size_t &len, const std::size_t &alphlen, const int &k,
+    shuffle_scratch_t &scratch);
+
+void euler_walk_ints(vec_int_t &out_ints, const std::size_t &start,
+    const std::size_t &len, const std::size_t &alphlen, const int &k,
+    rng_t &gen, shuffle_scratch_t &scratch);
+
+void shuffle_euler_ints(vec_int_t &seq_ints, const std::size_t &start,
+    const std::size_t &len, const std::size_t &alphlen, const int &k,
+    rng_t &gen, shuffle_scratch_t &scratch);
+
+void shuffle_local_ints(vec_int_t &seq_ints, const std::size_t &start,
+    const std::size_t &len, const std::size_t &alphlen, const int &k,
+    const int &method, rng_t &gen, shuffle_scratch_t &scratch);
 
 #endif
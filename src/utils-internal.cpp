@@ -1,5 +1,7 @@
 #include <Rcpp.h>
 #include <RcppThread.h>
+#include <thread>
+#include <algorithm>
 #include "types.h"
 
 extern const vec_str_t AMINOACIDS2 {
@@ -130,3 +132,11 @@ void print_motif(const list_num_t &motif) {
     RcppThread::Rcout << '\n';
   }
 }
+
+std::size_t parallel_batch_size(const std::size_t &n, const int &nthreads,
+    const std::size_t &max_size) {
+  std::size_t nt = nthreads > 0 ? nthreads : std::thread::hardware_concurrency();
+  nt = std::max(nt, std::size_t(1));
+  std::size_t size = (n + 4 * nt - 1) / (4 * nt);
+  return std::max(std::size_t(1), std::min(size, max_size));
+}
@@ -23,6 +23,11 @@ void print_motif(const list_int_t &motif);
 
 void print_motif(const list_num_t &motif);
 
+/* batch size for splitting n items between threads: small enough for every
+ * thread to get several batches, but at most max_size */
+std::size_t parallel_batch_size(const std::size_t &n, const int &nthreads,
+    const std::size_t &max_size);
+
 extern const Rcpp::StringVector AMINOACIDS;
 
 extern const vec_str_t AMINOACIDS2;